@@ -51,460 +51,1722 @@ uint8 g_DeviceTransducers[][TRANSDUCER_LABEL_LEN] = { "Light Ch 1      ",
 	                                                  "Light Ch 2      ",
 	                                                  "Light Ch 3      ",
 	                                                  "Light Ch 4      " };
-//! \var g_unActiveChannelRequest
-//! \brief Used in interupt to only read requested channel.                                           
-uint16 g_unActiveChannelRequest;	
-//! \var g_unADChannelA1
-//! \brief Stores readings from channel A1.                                                 
-uint16 g_unADChannelA1 = 0;
-//! \var g_unADChannelA2
-//! \brief Stores readings from channel A2. 
-uint16 g_unADChannelA2 = 0;
-//! \var g_unADChannelA3
-//! \brief Stores readings from channel A3. 
-uint16 g_unADChannelA3 = 0;
-//! \var g_unADChannelA4
-//! \brief Stores readings from channel A4. 
-uint16 g_unADChannelA4 = 0;
-//uint16 g_unADChannelA5 = 0;
-//uint16 g_unADChannelA6 = 0;
-//uint16 g_unADChannelA7 = 0;
-uint16 g_unTest1;
-uint16 g_unTest2;
-//volatile uint32 g_ulCounter = 0;
+//! \var g_saLightChannels
+//! \brief Light channel descriptors, kept in flash
+const S_LIGHT_CHANNEL g_saLightChannels[LIGHT_NUM_CHANNELS] = {
+  { AMP1_EN, INCH_0, LIGHT_SETTLE_TICKS, LIGHT_DEFAULT_AVG },	//channel 1, A0
+  { AMP1_EN, INCH_1, LIGHT_SETTLE_TICKS, LIGHT_DEFAULT_AVG },	//channel 2, A1
+  { AMP2_EN, INCH_2, LIGHT_SETTLE_TICKS, LIGHT_DEFAULT_AVG },	//channel 3, A2
+  { AMP2_EN, INCH_3, LIGHT_SETTLE_TICKS, LIGHT_DEFAULT_AVG } };	//channel 4, A3
+//! \var g_ulaLightAcc
+//! \brief Accumulator of each channel. 32 bits so deep averaging cannot overflow
+uint32 g_ulaLightAcc[LIGHT_NUM_CHANNELS];
+//! \var g_ulaLightRef
+//! \brief Accumulators of the VEREF+, -REF and AVDD/2 conversions
+uint32 g_ulaLightRef[3];
+//! \var g_unaLightRefQ4
+//! \brief Averaged VEREF+, -REF and AVDD/2 conversions of the last read, Q4
+uint16 g_unaLightRefQ4[3];
+//! \var g_unLightCompScale
+//! \brief Compensation gain of the last read in Q14, 0 when the reference is gone
+uint16 g_unLightCompScale;
+//! \var g_ulLightTempAcc
+//! \brief Accumulator of the temperature sensor conversions
+uint32 g_ulLightTempAcc;
+//! \var g_pulaLightSeqAcc
+//! \brief Accumulator of every ADC12MEMx in the running sequence, used by the ISR
+uint32 * g_pulaLightSeqAcc[LIGHT_NUM_CHANNELS + 4];
+//! \var g_ucLightSeqLen
+//! \brief Number of ADC12MEMx registers in the running sequence
+uint8 g_ucLightSeqLen = 0;
+//! \var g_pulLightBlockAcc
+//! \brief Accumulator of a block acquisition, 0 when blocks are filtered in RAM
+uint32 * g_pulLightBlockAcc = 0;
+//! \var g_ucaLightCapture
+//! \brief Packed raw samples of the last capture
+uint8 g_ucaLightCapture[LIGHT_CAPTURE_BYTES];
+//! \var g_pucLightCapture
+//! \brief Where the ISR packs the next block, 0 when not capturing
+uint8 * g_pucLightCapture = 0;
+//! \var g_iaLightGoertzelCoef
+//! \brief 2cos(2 pi f / LIGHT_FLICKER_HZ) in Q14 for 100, 120, 200 and 240 Hz
+const int16 g_iaLightGoertzelCoef[LIGHT_FLICKER_BINS] = { 26510, 23887, 10126, 2058 };
 //! \var g_uiCounter
 //! \brief used in while loops during read requests
-volatile uint8 g_uiCounter = 0;
+volatile uint16 g_uiCounter = 0;
+//! \var g_unLightTarget
+//! \brief Count at which an acquisition stops and wakes the CPU
+uint16 g_unLightTarget = 0;
+//! \var g_unLightTriggerTicks
+//! \brief Timer B period between conversions, 0 when software starts them
+uint16 g_unLightTriggerTicks = 0;
+//! \var g_ulLightTimedTicks
+//! \brief Duration of the timer triggered conversions since the stopwatch started
+uint32 g_ulLightTimedTicks = 0;
+//! \var g_ucLightOversample
+//! \brief Oversampling exponent n, 0 selects the plain average
+uint8 g_ucLightOversample = 0;
+//! \var g_ucLightFilter
+//! \brief Estimator of the single channel reads, one of the LIGHT_FILTER_ modes
+uint8 g_ucLightFilter = LIGHT_FILTER_MEAN;
+//! \var g_ucLightComp
+//! \brief Reference/supply compensation, one of the LIGHT_COMP_ modes
+uint8 g_ucLightComp = LIGHT_COMP_OFF;
+//! \var g_ucLightDark
+//! \brief Non zero when the dark offset is subtracted from the reads
+uint8 g_ucLightDark = 0;
+//! \var g_ucLightDarkValid
+//! \brief Channels with a dark offset
+uint8 g_ucLightDarkValid = 0;
+//! \var g_ucLightDarkSloped
+//! \brief Channels with a fitted temperature slope
+uint8 g_ucLightDarkSloped = 0;
+//! \var g_unaLightDarkQ4
+//! \brief Dark offset of every channel, 12 bit counts in Q4
+uint16 g_unaLightDarkQ4[LIGHT_NUM_CHANNELS];
+//! \var g_unaLightDarkTempQ4
+//! \brief Temperature sensor conversion every dark offset was taken at, Q4
+uint16 g_unaLightDarkTempQ4[LIGHT_NUM_CHANNELS];
+//! \var g_iaLightDarkSlope
+//! \brief Dark offset change per temperature count, LIGHT_DARK_SLOPE_SHIFT fraction bits
+int16 g_iaLightDarkSlope[LIGHT_NUM_CHANNELS];
+//! \var g_unLightTempQ4
+//! \brief Last temperature sensor conversion, Q4
+uint16 g_unLightTempQ4 = 0;
+//! \var g_ucLightTempAge
+//! \brief Reads since the temperature sensor was converted
+uint8 g_ucLightTempAge = LIGHT_TEMP_READS;
+//! \var g_ucLightNoiseQ4
+//! \brief Noise target of the adaptive reads in Q4 counts, 0 keeps the count fixed
+uint8 g_ucLightNoiseQ4 = 0;
+//! \var g_unLightAdaptMin
+//! \brief Fewest samples an adaptive read takes
+uint16 g_unLightAdaptMin = LIGHT_ADAPT_MIN_AVG;
+//! \var g_unLightAdaptMax
+//! \brief Most samples an adaptive read takes
+uint16 g_unLightAdaptMax = LIGHT_ADAPT_MAX_AVG;
+//! \var g_unLightAdaptCount
+//! \brief Samples taken by the last read when it was adaptive, else 0
+uint16 g_unLightAdaptCount = 0;
+//! \var g_unaLightBlock
+//! \brief Raw samples of the last block, sorted in place by the robust filters
+uint16 g_unaLightBlock[ADC12_NUM_MEM];
+//! \var g_ucLightCalMask
+//! \brief Channels with a calibration, bit 0 is channel 1
+uint8 g_ucLightCalMask = 0;
+//! \var g_iaLightCal
+//! \brief Offset, gain and quad term of every channel
+int16 g_iaLightCal[LIGHT_NUM_CHANNELS][3];
+//! \var g_ucLightSettled
+//! \brief Set by the Timer B ISR when the settle delay has elapsed
+volatile uint8 g_ucLightSettled = 0;
+//! \var g_unaLightSettleTicks
+//! \brief Per-channel settle delay in SMCLK/2 ticks set at runtime, 0 uses the descriptor
+uint16 g_unaLightSettleTicks[LIGHT_NUM_CHANNELS];
+//! \var g_unaLightPhaseTicks
+//! \brief Duration of each phase of the last read in SMCLK/2 ticks
+uint16 g_unaLightPhaseTicks[LIGHT_NUM_PHASES];
+//! \var g_unLightFirstConvTicks
+//! \brief Conversion time of the first amp group of the last pipelined read
+uint16 g_unLightFirstConvTicks = 0;
+//! \var g_ucLightHold
+//! \brief Non zero while the front end is held up between reads
+uint8 g_ucLightHold = 0;
+//! \var g_ucLightPowered
+//! \brief Non zero while the ADC and VREF are powered
+uint8 g_ucLightPowered = 0;
+//! \var g_ucLightAmpsWarm
+//! \brief AMPx_EN bits of the op-amps held on and settled
+uint8 g_ucLightAmpsWarm = 0;
 
 
 
 //!
 //! \brief Starts up the ADC and enables reference voltage
+//!
+//! While the front end is held only the ADC core is switched back on.
+//!
 void vLight_Init(void)
 {
+  if (g_ucLightHold && g_ucLightPowered)
+  {
+    ADC12CTL0 |= ADC12ON;			//turn on ADC
+    return;
+  }
+
   vADC12_Init();
   P_AMP_EN_OUT &= ~VREF_EN;			//enable VREF
   ADC12CTL0 |= ADC12ON;				//turn on ADC
+  g_ucLightPowered = 1;
 }
 
+//!
+//! \brief Shuts down the ADC and disables reference voltage
+//!
+//! Does nothing while the front end is held, vLIGHT_Hold() releases it.
+//!
 void vLight_Shutdown(void)
 {
+  if (g_ucLightHold)
+    return;
+
   vADC12_Shutdown();
   P_AMP_EN_OUT |= VREF_EN;					//disable VREF
+  g_ucLightPowered = 0;
 }
+
 //!
-//! \brief Reads Light Channel 1.
-//! 
-//! Takes in two variables, the first is total number of readings to
-//! average, the second is an unused dummy. Returns avg. light reading
-//! from light channel 1.
+//! \brief Holds the analog front end up between reads.
+//!
+//! While held, vLight_Init() and vLight_Shutdown() leave the ADC
+//! configuration, VREF and the op-amps alone, so transducers run back to
+//! back pay the set up and settle delays once. Releasing the hold powers
+//! everything down.
 //!
-//! \param punAvgCount	Number of readings to avg. over.
-//! \param punDummy		Currently not used.
+//! \param ucHold	Non zero to hold, 0 to release.
 //!
-uint16 unLIGHT_ReadChannel_1(uint16 * punAvgCount, uint16 * punDummy)
+void vLIGHT_Hold(uint8 ucHold)
 {
+  if (ucHold)
+  {
+    g_ucLightHold = 1;
+    return;
+  }
 
-  //needed for all channel readings
-  g_uiCounter = 0;
+  if (!g_ucLightHold)
+    return;
 
-  //insert 17ms delay here using TIMER B
-  TBCTL |= CNTL_0;					//16-BIT MAX 0FFFFXh
-  TBCTL |= TBSSEL1;					//SOURCE SMCLK
-  TBCTL &= ~TBSSEL0;				//SOURCE SMCLK
-  TBCTL |= ID_1;					//DIVIDER TO 2
-  TBCCR0 = 0X84D0;					//COUNT UP VALUE 34K CYCLES
-  TBCTL |= MC_1;					//UP MODE
+  g_ucLightHold = 0;
+  P_AMP_EN_OUT |= g_ucLightAmpsWarm;	//disable opAmps
+  g_ucLightAmpsWarm = 0;
+  if (g_ucLightPowered)
+    vLight_Shutdown();
+}
+
+//!
+//! \brief Returns non zero while the ADC and VREF are powered.
+//!
+uint8 ucLIGHT_IsPowered(void)
+{
+  return g_ucLightPowered;
+}
+//!
+//! \brief Sets the settle delay used before a channel is converted.
+//!
+//! \param ucChannel	Light channel (1-4).
+//! \param unTicks		Delay in SMCLK/2 ticks, 0 restores the descriptor default.
+//!
+void vLIGHT_SetSettleTicks(uint8 ucChannel, uint16 unTicks)
+{
+  if (ucChannel == 0 || ucChannel > LIGHT_NUM_CHANNELS)
+    return;
+
+  g_unaLightSettleTicks[ucChannel - 1] = unTicks;
+}
+
+//!
+//! \brief Selects oversampling and decimation for the following reads.
+//!
+//! With an exponent n the reads take 4^n samples into the 32-bit
+//! accumulators and shift the sum right by n, giving 12+n effective bits.
+//! An exponent of 0 returns to plain averaging over *punAvgCount samples.
+//!
+//! \param ucExponent	Oversampling exponent (0 to LIGHT_MAX_OVERSAMPLE).
+//!
+void vLIGHT_SetOversampling(uint8 ucExponent)
+{
+  if (ucExponent > LIGHT_MAX_OVERSAMPLE)
+    ucExponent = LIGHT_MAX_OVERSAMPLE;
+
+  g_ucLightOversample = ucExponent;
+}
+
+//!
+//! \brief Selects the estimator used by the single channel reads.
+//!
+//! The robust modes keep every 16 sample block in RAM, reduce it to its
+//! median or trimmed mean and average the block results, so a spike only
+//! moves the reading when it makes up a large part of a block. The sample
+//! count is rounded up to whole blocks. Unknown modes select the mean.
+//!
+//! \param ucMode	One of the LIGHT_FILTER_ modes.
+//!
+void vLIGHT_SetFilter(uint8 ucMode)
+{
+  if (ucMode > LIGHT_FILTER_TRIMMED)
+    ucMode = LIGHT_FILTER_MEAN;
+
+  g_ucLightFilter = ucMode;
+}
+
+//!
+//! \brief Selects the reference/supply compensation of the reads.
+//!
+//! When enabled every read also converts VEREF+, -REF and AVDD/2. The
+//! sweep adds them to its sequence, single channel reads run 16 short
+//! reference sequences after the channel. Unknown modes turn it off.
+//!
+//! \param ucMode	One of the LIGHT_COMP_ modes.
+//!
+void vLIGHT_SetCompensation(uint8 ucMode)
+{
+  if (ucMode > LIGHT_COMP_SUPPLY)
+    ucMode = LIGHT_COMP_OFF;
+
+  g_ucLightComp = ucMode;
+}
+
+//!
+//! \brief Selects adaptive averaging for the single channel reads.
+//!
+//! An adaptive read converts a pilot block of 16 samples, estimates the
+//! noise of the channel from it and takes the fewest whole blocks whose
+//! mean has a standard error within the target, between the bounds. The
+//! pilot counts towards the average. Reads with oversampling, a robust
+//! filter or more than one channel keep their fixed count.
+//!
+//! \param ucNoiseQ4	Standard error target in Q4 counts, 0 turns it off.
+//! \param unMin		Fewest samples, rounded up to 16.
+//! \param unMax		Most samples, rounded up to 16, at least unMin.
+//!
+void vLIGHT_SetAdaptive(uint8 ucNoiseQ4, uint16 unMin, uint16 unMax)
+{
+  if (unMin < ADC12_NUM_MEM)
+    unMin = ADC12_NUM_MEM;
+  if (unMax > LIGHT_ADAPT_LIMIT)
+    unMax = LIGHT_ADAPT_LIMIT;
+  if (unMax < unMin)
+    unMax = unMin;
+
+  g_ucLightNoiseQ4 = ucNoiseQ4;
+  g_unLightAdaptMin = (unMin + ADC12_NUM_MEM - 1) & ~(ADC12_NUM_MEM - 1);
+  g_unLightAdaptMax = (unMax + ADC12_NUM_MEM - 1) & ~(ADC12_NUM_MEM - 1);
+}
+
+//!
+//! \brief Returns the samples averaged by the last read when it was adaptive.
+//!
+//! \return The sample count, 0 when the last read had a fixed count.
+//!
+uint16 unLIGHT_GetAdaptiveCount(void)
+{
+  return g_unLightAdaptCount;
+}
+
+//!
+//! \brief Selects the dark offset subtraction of the reads.
+//!
+//! When enabled the reads convert the on-chip temperature sensor after
+//! their channels, every LIGHT_TEMP_READS reads. Channels without a dark
+//! offset, or whose offset model does not cover the temperature, are
+//! converted again with their op-amps off and the result is cached as
+//! their offset. The modeled offset of op-amp and photodiode is then
+//! subtracted from every reading.
+//!
+//! \param ucEnable	Non zero to subtract the dark offset.
+//!
+void vLIGHT_SetDarkCorrection(uint8 ucEnable)
+{
+  //switching it on converts the sensor on the next read, the model is
+  //otherwise kept across commands and sweeps
+  if (ucEnable && !g_ucLightDark)
+    g_ucLightTempAge = LIGHT_TEMP_READS;
+  g_ucLightDark = (ucEnable != 0);
+}
+
+//!
+//! \brief Selects timer triggered sampling for the following reads.
+//!
+//! At a non zero rate Timer B output 1 starts every conversion, so the
+//! samples are evenly spaced and the CPU sleeps until a sequence or a 16
+//! sample block is complete. Rates the ADC cannot follow are limited to
+//! the fastest usable one, rates below about 31 Hz to the slowest.
+//!
+//! \param unRateHz	Conversions per second, 0 returns to software starts.
+//!
+void vLIGHT_SetSampleRate(uint16 unRateHz)
+{
+  uint32 ulTicks;
 
-  while(!(TBCTL & TBIFG));			//DELAY UNTIL IFG THROWN
-  TBCTL &= ~(TBIFG | MC0 | MC1);	//CLEAR B TIMER
+  if (unRateHz == 0)
+  {
+    g_unLightTriggerTicks = 0;
+    return;
+  }
 
-  P_AMP_EN_OUT &= ~AMP1_EN;			//enable opAmp channels A0/A1
+  //configuration path, one library divide per rate change
+  ulTicks = LIGHT_TIMER_HZ / unRateHz;
+  if (ulTicks > 0xFFFF)
+    ulTicks = 0xFFFF;
+  if (ulTicks < LIGHT_MIN_TRIGGER_TICKS)
+    ulTicks = LIGHT_MIN_TRIGGER_TICKS;
 
-  g_unADChannelA1 = 0;				//reset variables
-  g_unActiveChannelRequest = 1;		//channel 1 request
+  g_unLightTriggerTicks = (uint16)ulTicks;
+}
 
-  ADC12CTL1 &= ~(BITF | BITE | BITD | BITC);//SETS START ADDRESS A0
-  ADC12IE |= BIT0;					//set interupts on A0
-  ADC12IFG &= ~BIT0;				//CLEAR FLAG INSURE
+//!
+//! \brief Loads the calibration table.
+//!
+//! \param pucTable	Table in the format described in light.h.
+//! \param ucLen		Length of the table.
+//! \return 0 when loaded, 1 when the table is not valid (calibration off).
+//!
+uint8 ucLIGHT_LoadCalibration(volatile uint8 * pucTable, uint8 ucLen)
+{
+  uint8 ucChannel;
+  uint8 ucTerm;
+  uint8 ucMask;
 
-  while(g_uiCounter < * punAvgCount)
+  g_ucLightCalMask = 0;
+
+  if (ucLen != LIGHT_CAL_LEN || pucTable[0] != LIGHT_CAL_MARKER)
+    return 1;
+
+  ucMask = pucTable[1];
+  pucTable += 2;
+  for (ucChannel = 0; ucChannel < LIGHT_NUM_CHANNELS; ucChannel++)
   {
-  ADC12CTL0 |= ENC;					//ENABLE ADC
-  ADC12CTL0 |= ADC12SC;				//ENABLE ADC12 START SAMPLE
-  __bis_SR_register(GIE + LPM0_bits);
+    for (ucTerm = 0; ucTerm < 3; ucTerm++)
+    {
+      g_iaLightCal[ucChannel][ucTerm] = (int16)(((uint16)pucTable[0] << 8) | pucTable[1]);
+      pucTable += 2;
+    }
   }
 
-  ADC12IE &= ~BIT0;					//disable interupt A0
-  ADC12CTL0 &= ~ENC;				//disable ADC
-  ADC12CTL0 &= ~ADC12ON;			//turn off ADC
+  g_ucLightCalMask = ucMask & ((1 << LIGHT_NUM_CHANNELS) - 1);
+  return 0;
+}
+
+//!
+//! \brief Converts a reading to engineering units.
+//!
+//! \param ucChannel		Channel index (0-3).
+//! \param unRaw			The reading.
+//! \param ucResolution	Effective bits of the reading.
+//! \return The calibrated value clipped to 0-65535, or the reading when
+//! the channel has no calibration.
+//!
+uint16 unLIGHT_Calibrate(uint8 ucChannel, uint16 unRaw, uint8 ucResolution)
+{
+  int16 iX;
+  int32 lY;
+
+  if (!(g_ucLightCalMask & (1 << ucChannel)))
+    return unRaw;
+
+  //scale to a Q15 fraction of full scale
+  if (ucResolution > 15)
+    iX = (int16)(unRaw >> (ucResolution - 15));
+  else
+    iX = (int16)(unRaw << (15 - ucResolution));
 
-  P_AMP_EN_OUT |= AMP1_EN;			//disable opAmp channels A0/A1
-  return g_unADChannelA1 /= * punAvgCount;
+  lY = g_iaLightCal[ucChannel][0];
+  lY += iFIXMATH_MulQ15(g_iaLightCal[ucChannel][1], iX);
+  lY += iFIXMATH_MulQ15(g_iaLightCal[ucChannel][2], iFIXMATH_MulQ15(iX, iX));
+
+  if (lY < 0)
+    return 0;
+  if (lY > 0xFFFF)
+    return 0xFFFF;
+  return (uint16)lY;
 }
 
 //!
-//! \brief Reads Light Channel 2
-//! 
-//! Takes in two variables, the first is total number of readings to
-//! average, the second is an unused dummy. Returns avg. light reading
-//! from light channel 2.
+//! \brief Returns the effective resolution of the reads in bits.
+//!
+uint8 ucLIGHT_GetResolution(void)
+{
+  return LIGHT_ADC_BITS + g_ucLightOversample;
+}
+
+//!
+//! \brief Returns the duration of a phase of the last read.
 //!
-//! \param punAvgCount	Number of readings to avg. over.
-//! \param punDummy		Currently not used.
+//! \param ucPhase	LIGHT_PHASE_x.
+//! \return SMCLK/2 ticks, 0xFFFF if the phase was longer than the timer.
 //!
+uint16 unLIGHT_GetPhaseTicks(uint8 ucPhase)
+{
+  if (ucPhase >= LIGHT_NUM_PHASES)
+    return 0;
+
+  return g_unaLightPhaseTicks[ucPhase];
+}
 
-uint16 unLIGHT_ReadChannel_2(uint16 * punAvgCount, uint16 * punDummy)
+//!
+//! \brief Returns the number of samples a read has to accumulate.
+//!
+//! \param punAvgCount	Requested count, 0 (or no pointer) uses the default
+//!						averaging of the channel descriptor.
+//! \param ucIdx		Index of the first channel read.
+//!
+static uint16 unLIGHT_SampleCount(uint16 * punAvgCount, uint8 ucIdx)
 {
+  if (g_ucLightOversample)
+    return (uint16)1 << (g_ucLightOversample << 1);	//4^n samples
 
-  //needed for all channel readings
-  g_uiCounter = 0;
+  if (punAvgCount == 0 || *punAvgCount == 0)
+    return g_saLightChannels[ucIdx].unAvgCount;
 
-  //insert 17ms delay here using TIMER B
-  TBCTL |= CNTL_0;					//16-BIT MAX 0FFFFXh
-  TBCTL |= TBSSEL1;					//SOURCE SMCLK
-  TBCTL &= ~TBSSEL0;				//SOURCE SMCLK
-  TBCTL |= ID_1;					//DIVIDER TO 2
-  TBCCR0 = 0X84D0;					//COUNT UP VALUE 34K CYCLES
-  TBCTL |= MC_1;					//UP MODE
+  return *punAvgCount;
+}
+
+//!
+//! \brief Returns the number of 16 sample blocks a robust read takes.
+//!
+static uint16 unLIGHT_BlockCount(uint16 unCount)
+{
+  if (unCount < ADC12_NUM_MEM)
+    return 1;
+
+  return (unCount + ADC12_NUM_MEM - 1) >> 4;
+}
 
-  while(!(TBCTL & TBIFG));			//DELAY UNTIL IFG THROWN
-  TBCTL &= ~(TBIFG | MC0 | MC1);	//CLEAR B TIMER
-  P_AMP_EN_OUT &= ~AMP1_EN;			//enable opAmp channels A0/A1
+//!
+//! \brief Reduces an accumulated sum to the reported reading.
+//!
+//! Decimation only needs a shift, so does the plain average over a power
+//! of two count. After a robust read the sum holds one Q4 estimate per
+//! block, which is averaged over the blocks and scaled to the effective
+//! resolution.
+//!
+static uint16 unLIGHT_Reduce(uint32 ulSum, uint16 unCount, uint8 ucFilter)
+{
+  uint16 unBlocks;
 
-  g_unADChannelA2 = 0;				//reset variables
-  g_unActiveChannelRequest = 2;		//channel 1 request
+  if (ucFilter != LIGHT_FILTER_MEAN)
+  {
+    unBlocks = unLIGHT_BlockCount(unCount);
+    return (uint16)(ulFIXMATH_Average((ulSum << g_ucLightOversample) + ((uint32)unBlocks << 3),
+                                      unBlocks) >> 4);
+  }
 
-  ADC12CTL1 |= CSTARTADD_1;			//SETS START ADDRESS A1
-  ADC12IE |= BIT1;					//set interupts on A1
-  ADC12IFG &= ~BIT1;				//CLEAR FLAG INSURE
+  if (g_ucLightOversample)
+    return (uint16)(ulSum >> g_ucLightOversample);
 
-  while(g_uiCounter < *punAvgCount)
+  return (uint16)ulFIXMATH_Average(ulSum, unCount);
+}
+
+//!
+//! \brief Derives the compensation gain from the reference conversions.
+//!
+//! The -REF conversion is the zero point in both modes, the span is
+//! VEREF+ (full scale) or AVDD/2 (nominal supply). The gain target/span is
+//! kept in Q14 so every channel of the read is scaled with one multiply,
+//! the single division is paid once per read.
+//!
+static void vLIGHT_UpdateCompScale(void)
+{
+  int32 lSpan;
+  uint32 ulScale;
+  uint16 unTarget;
+
+  if (g_ucLightComp == LIGHT_COMP_REF)
+  {
+    lSpan = (int32)g_unaLightRefQ4[0] - g_unaLightRefQ4[1];
+    unTarget = 0xFFF0;				//full scale in Q4
+  }
+  else
   {
-  ADC12CTL0 |= ENC;					//ENABLE ADC
-  ADC12CTL0 |= ADC12SC;				//ENABLE ADC12 START SAMPLE
-  __bis_SR_register(GIE + LPM0_bits);
+    lSpan = (int32)g_unaLightRefQ4[2] - g_unaLightRefQ4[1];
+    unTarget = LIGHT_AVDD_NOMINAL_Q4;
   }
 
-  ADC12IE &= ~BIT1;					//disable interupt A0
-  ADC12CTL0 &= ~ENC;				//disable ADC
-  ADC12CTL0 &= ~ADC12ON;			//turn off ADC
+  //a collapsed span means the reference is gone
+  g_unLightCompScale = 0;
+  if (lSpan <= 0)
+    return;
 
-  P_AMP_EN_OUT |= AMP1_EN;			//disable opAmp channels A0/A1
-  return g_unADChannelA2 /= *punAvgCount;
+  //the span is measured, no reciprocal constant exists; one divide per
+  //read scales every channel of it by multiplies
+  ulScale = ((uint32)unTarget << 14) / (uint32)lSpan;
+  if (ulScale > 0xFFFF)
+    ulScale = 0xFFFF;
+  g_unLightCompScale = (uint16)ulScale;
+}
 
+//!
+//! \brief Evaluates the dark offset model of a channel.
+//!
+//! The cached offset, moved along the slope of the channel to the last
+//! temperature conversion. The temperature change is limited to the span
+//! the model covers.
+//!
+//! \param ucIdx	Channel index (0-3) with a dark offset.
+//! \return The offset in Q4 of the 12 bit scale.
+//!
+static int32 lLIGHT_DarkOffset(uint8 ucIdx)
+{
+  int32 lDelta;
+
+  if (!(g_ucLightDarkSloped & (1 << ucIdx)))
+    return g_unaLightDarkQ4[ucIdx];
+
+  lDelta = (int32)g_unLightTempQ4 - g_unaLightDarkTempQ4[ucIdx];
+  if (lDelta > LIGHT_DARK_MODEL_SPAN)
+    lDelta = LIGHT_DARK_MODEL_SPAN;
+  if (lDelta < -LIGHT_DARK_MODEL_SPAN)
+    lDelta = -LIGHT_DARK_MODEL_SPAN;
+
+  return g_unaLightDarkQ4[ucIdx]
+         + (lFIXMATH_MulS16(g_iaLightDarkSlope[ucIdx], (int16)lDelta) >> LIGHT_DARK_SLOPE_SHIFT);
 }
 
 //!
-//! \brief Reads Light Channel 3
-//! 
-//! Takes in two variables, the first is total number of readings to
-//! average, the second is an unused dummy. Returns avg. light reading
-//! from light channel 3.
+//! \brief Applies the dark offset and reference/supply compensation to a reading.
 //!
-//! \param punAvgCount	Number of readings to avg. over.
-//! \param punDummy		Currently not used.
+//! The reading is brought to Q4 of the 12 bit scale, which is exact for
+//! every oversampling exponent, offset by the modeled dark offset of the
+//! channel or else the -REF conversion, scaled by the gain from
+//! vLIGHT_UpdateCompScale() and scaled back.
 //!
+static uint16 unLIGHT_Compensate(uint16 unReading, uint8 ucIdx)
+{
+  uint8 ucShift;
+  uint8 ucScale;
+  uint8 ucDark;
+  int32 lValue;
+
+  //without a reference or a dark offset the reading is left alone
+  ucScale = (g_ucLightComp != LIGHT_COMP_OFF && g_unLightCompScale != 0);
+  ucDark = (g_ucLightDark && (g_ucLightDarkValid & (1 << ucIdx)));
+  if (!ucScale && !ucDark)
+    return unReading;
+
+  ucShift = 4 - g_ucLightOversample;
 
-uint16 unLIGHT_ReadChannel_3(uint16 * punAvgCount, uint16 * punDummy)
+  lValue = (int32)unReading << ucShift;
+  if (ucDark)
+    lValue -= lLIGHT_DarkOffset(ucIdx);
+  else
+    lValue -= g_unaLightRefQ4[1];
+  if (lValue <= 0)
+    return 0;
+
+  if (ucScale)
+    lValue = unFIXMATH_ScaleQ14((uint16)lValue, g_unLightCompScale);
+  if (lValue > 0xFFF0)
+    lValue = 0xFFF0;
+
+  return (uint16)(lValue >> ucShift);
+}
+
+//!
+//! \brief Returns the settle delay of a channel.
+//!
+static uint16 unLIGHT_SettleTicks(uint8 ucIdx)
 {
+  if (g_unaLightSettleTicks[ucIdx])
+    return g_unaLightSettleTicks[ucIdx];
 
-  //needed for all channel readings
-  g_uiCounter = 0;
+  return g_saLightChannels[ucIdx].unSettleTicks;
+}
+
+//!
+//! \brief Returns the longest settle delay of a set of channels.
+//!
+//! Channels behind an op-amp that is held warm need no delay.
+//!
+//! \param ucMask	Channels, bit 0 is channel 1.
+//! \param pucAmps	Receives the AMPx_EN bits of the channels.
+//!
+static uint16 unLIGHT_GroupSettle(uint8 ucMask, uint8 * pucAmps)
+{
+  uint16 unTicks;
+  uint8 ucIdx;
+
+  unTicks = 0;
+  *pucAmps = 0;
+  for (ucIdx = 0; ucIdx < LIGHT_NUM_CHANNELS; ucIdx++)
+  {
+    if (ucMask & (1 << ucIdx))
+    {
+      *pucAmps |= g_saLightChannels[ucIdx].ucAmpPin;
+      if (g_saLightChannels[ucIdx].ucAmpPin & g_ucLightAmpsWarm)
+        continue;
+      if (unLIGHT_SettleTicks(ucIdx) > unTicks)
+        unTicks = unLIGHT_SettleTicks(ucIdx);
+    }
+  }
+
+  return unTicks;
+}
+
+//!
+//! \brief Starts Timer B free running to time a phase.
+//!
+static void vLIGHT_StartStopwatch(void)
+{
+  g_ulLightTimedTicks = 0;
+  TBCCTL0 = 0;						//NO CCR0 INTERRUPT
+  TBCTL = TBSSEL_2 | ID_1 | TBCLR;	//SMCLK/2, 16-BIT, CLEARED
+  TBCTL |= MC_2;					//CONTINUOUS MODE
+}
+
+//!
+//! \brief Stops Timer B and returns the ticks since vLIGHT_StartStopwatch().
+//!
+static uint16 unLIGHT_StopwatchTicks(void)
+{
+  uint16 unTicks;
+
+  //Timer B paced the conversions, their duration is known
+  if (g_unLightTriggerTicks)
+  {
+    if (g_ulLightTimedTicks > 0xFFFF)
+      return 0xFFFF;
+    return (uint16)g_ulLightTimedTicks;
+  }
+
+  unTicks = TBR;
+  if (TBCTL & TBIFG)				//TIMER WRAPPED
+    unTicks = 0xFFFF;
+  TBCTL &= ~(MC0 | MC1 | TBIFG);	//STOP TIMER B
+
+  return unTicks;
+}
 
-  //insert 17ms delay here using TIMER B
-  TBCTL |= CNTL_0;					//16-BIT MAX 0FFFFXh
-  TBCTL |= TBSSEL1;					//SOURCE SMCLK
-  TBCTL &= ~TBSSEL0;				//SOURCE SMCLK
-  TBCTL |= ID_1;					//DIVIDER TO 2
-  TBCCR0 = 0X84D0;					//COUNT UP VALUE 34K CYCLES
+//!
+//! \brief Waits for the reference and op-amps to settle in LPM0.
+//!
+//! Timer B counts SMCLK/2 in up mode and TIMERB0_ISR wakes the CPU once
+//! TBCCR0 is reached. SMCLK must stay on to clock the timer, so LPM0 is
+//! the deepest mode that can be used here.
+//!
+//! \param unTicks	Delay in SMCLK/2 ticks (0x84D0 is roughly 17ms).
+//!
+static void vLIGHT_SettleDelay(uint16 unTicks)
+{
+  g_ucLightSettled = 0;
+
+  TBCTL = TBSSEL_2 | ID_1 | TBCLR;	//SMCLK/2, 16-BIT, CLEARED
+  TBCCR0 = unTicks;					//COUNT UP VALUE
+  TBCCTL0 = CCIE;					//INTERRUPT ON CCR0
   TBCTL |= MC_1;					//UP MODE
 
-  while(!(TBCTL & TBIFG));			//DELAY UNTIL IFG THROWN
-  TBCTL &= ~(TBIFG | MC0 | MC1);	//CLEAR B TIMER
-  P_AMP_EN_OUT &= ~AMP2_EN;			//enable opAmp channels A2/A3
+  //interrupts stay off between testing the flag and entering LPM0 so the
+  //wakeup cannot be lost
+  __disable_interrupt();
+  while (!g_ucLightSettled)
+  {
+    __bis_SR_register(GIE + LPM0_bits);
+    __disable_interrupt();
+  }
+  __enable_interrupt();
+}
+
+//!
+//! \brief Sleeps in LPM0 until the ADC ISR has counted unCount samples.
+//!
+//! Interrupts stay off between testing the counter and entering LPM0 so
+//! the wakeup cannot be lost. Other interrupts that end LPM0 early (the
+//! background sampling timer) just send the CPU back to sleep.
+//!
+static void vLIGHT_WaitForSamples(uint16 unCount)
+{
+  __disable_interrupt();
+  while (g_uiCounter < unCount)
+  {
+    __bis_SR_register(GIE + LPM0_bits);
+    __disable_interrupt();
+  }
+  __enable_interrupt();
+}
 
-  g_unADChannelA3 = 0;				//reset variables
-  g_unActiveChannelRequest = 3;		//channel 3 request
+//!
+//! \brief Starts Timer B output 1 as the conversion trigger.
+//!
+//! Timer B counts SMCLK/2 in up mode. Output 1 is set at TBCCR1 and reset
+//! at TBCCR0 (OUTMOD_3), one rising edge per period, and each rising edge
+//! starts a sample through SHS_3. ENC must be clear.
+//!
+static void vLIGHT_StartTrigger(void)
+{
+  ADC12CTL0 &= ~MSC;				//ONE CONVERSION PER TRIGGER
+  ADC12CTL1 |= SHS_3;				//TBOUT1 STARTS SAMPLES
 
-  ADC12CTL1 |= CSTARTADD_2;			//SET ADD TO A2
-  ADC12IE |= BIT2;					//set interupts on A2
-  ADC12IFG &= ~BIT2;				//CLEAR FLAG INSURE
+  TBCCTL0 = 0;						//NO CCR0 INTERRUPT
+  TBCTL = TBSSEL_2 | ID_1 | TBCLR;	//SMCLK/2, 16-BIT, CLEARED
+  TBCCR0 = g_unLightTriggerTicks - 1;	//TRIGGER PERIOD
+  TBCCR1 = g_unLightTriggerTicks >> 1;	//RISING EDGE HALF WAY
+  TBCCTL1 = OUTMOD_3;				//SET/RESET
+  TBCTL |= MC_1;					//UP MODE
+}
 
-  while(g_uiCounter < *punAvgCount)
+//!
+//! \brief Stops the conversion trigger and returns to software starts.
+//!
+//! \param ulSamples	Number of conversions triggered, for the phase timing.
+//!
+static void vLIGHT_StopTrigger(uint32 ulSamples)
+{
+  TBCTL &= ~(MC0 | MC1);			//STOP TIMER B
+  TBCCTL1 = 0;						//OUTPUT 1 LOW
+  ADC12CTL0 &= ~ENC;
+  ADC12CTL1 &= ~SHS_3;				//ADC12SC STARTS SAMPLES
+
+  g_ulLightTimedTicks += ulSamples * g_unLightTriggerTicks;
+}
+
+//!
+//! \brief Packs the channels of a read into one ADC12 sequence.
+//!
+//! The inputs of the selected channels go to ADC12MEM0 onwards, followed
+//! by VEREF+, -REF and AVDD/2 with LIGHT_SEQ_REFS and the temperature
+//! sensor with LIGHT_SEQ_TEMP, and EOS marks the last register. The
+//! accumulator of every register is recorded for the ISR. ENC must be clear.
+//!
+//! \param ucMask	Channels to convert, bit 0 is channel 1.
+//! \param ucExtra	LIGHT_SEQ_ flags of the channels to append.
+//! \return The last ADC12MEMx of the sequence.
+//!
+static uint8 ucLIGHT_ConfigSequence(uint8 ucMask, uint8 ucExtra)
+{
+  volatile uint8 * pucMemCtl;
+  uint8 ucIdx;
+  uint8 ucLen;
+
+  pucMemCtl = &ADC12MCTL0;
+  ucLen = 0;
+
+  for (ucIdx = 0; ucIdx < LIGHT_NUM_CHANNELS; ucIdx++)
   {
-  ADC12CTL0 |= ENC;					//ENABLE ADC
-  ADC12CTL0 |= ADC12SC;				//ENABLE ADC12 START SAMPLE
-  __bis_SR_register(GIE + LPM0_bits);
+    if (ucMask & (1 << ucIdx))
+    {
+      pucMemCtl[ucLen] = SREF_2 | g_saLightChannels[ucIdx].ucInput;
+      g_pulaLightSeqAcc[ucLen++] = &g_ulaLightAcc[ucIdx];
+    }
   }
 
-  ADC12IE &= ~BIT2;					//disable interupt A0
-  ADC12CTL0 &= ~ENC;				//disable ADC
-  ADC12CTL0 &= ~ADC12ON;			//turn off ADC
+  if (ucExtra & LIGHT_SEQ_REFS)
+  {
+    pucMemCtl[ucLen] = SREF_2 | INCH_8;		//VEREF+
+    g_pulaLightSeqAcc[ucLen++] = &g_ulaLightRef[0];
+    pucMemCtl[ucLen] = SREF_2 | INCH_9;		//-REF
+    g_pulaLightSeqAcc[ucLen++] = &g_ulaLightRef[1];
+    pucMemCtl[ucLen] = SREF_2 | INCH_11;	//AVDD/2
+    g_pulaLightSeqAcc[ucLen++] = &g_ulaLightRef[2];
+  }
 
-  P_AMP_EN_OUT |= AMP2_EN;			//disable opAmp channels A2/A3
-  return g_unADChannelA3 /= *punAvgCount;
+  if (ucExtra & LIGHT_SEQ_TEMP)
+  {
+    pucMemCtl[ucLen] = SREF_2 | INCH_10;	//temperature sensor
+    g_pulaLightSeqAcc[ucLen++] = &g_ulLightTempAcc;
+  }
+
+  pucMemCtl[ucLen - 1] |= EOS;
+  g_ucLightSeqLen = ucLen;
+  return ucLen - 1;
 }
 
 //!
-//! \brief Reads Light Channel 4
-//! 
-//! Takes in two variables, the first is total number of readings to
-//! average, the second is an unused dummy. Returns avg. light reading
-//! from light channel 4.
+//! \brief Converts a packed sequence unCount times.
 //!
-//! \param punAvgCount	Number of readings to avg. over.
-//! \param punDummy		Currently not used.
+//! One software trigger runs the whole sequence (CONSEQ_1, MSC) and the
+//! ISR adds every register to its accumulator when the last one is
+//! loaded, so the CPU wakes once per sequence. With timer triggered
+//! sampling the sequence repeats (CONSEQ_3) one conversion per trigger
+//! until the ISR stops it after unCount sequences.
 //!
+//! \param ucMask	Channels to convert, bit 0 is channel 1.
+//! \param ucExtra	LIGHT_SEQ_ flags of the channels to append.
+//! \param unCount	Number of sequences.
+//!
+static void vLIGHT_RunSequence(uint8 ucMask, uint8 ucExtra, uint16 unCount)
+{
+  uint16 unEndBit;
+  uint16 unNext;
+
+  unEndBit = 1 << ucLIGHT_ConfigSequence(ucMask, ucExtra);
 
-uint16 unLIGHT_ReadChannel_4(uint16 * punAvgCount, uint16 * punDummy)
+  g_uiCounter = 0;
+  g_unLightTarget = unCount;
+  ADC12CTL1 &= ~(CSTARTADD_15 | CONSEQ_3);	//START ADDRESS A0
+  ADC12IFG = 0;						//CLEAR FLAGS INSURE
+  ADC12IE |= unEndBit;				//interupt once sequence completes
+
+  if (g_unLightTriggerTicks)
+  {
+    ADC12CTL1 |= CONSEQ_3;			//REPEAT SEQUENCE
+    vLIGHT_StartTrigger();
+    ADC12CTL0 |= ENC;				//ENABLE ADC, TIMER STARTS SAMPLES
+    vLIGHT_WaitForSamples(unCount);
+    vLIGHT_StopTrigger((uint32)unCount * g_ucLightSeqLen);
+  }
+  else
+  {
+    ADC12CTL1 |= CONSEQ_1;			//SEQUENCE OF CHANNELS
+    ADC12CTL0 |= MSC;				//ONE TRIGGER RUNS WHOLE SEQUENCE
+
+    for (unNext = 1; unNext <= unCount; unNext++)
+    {
+      ADC12CTL0 |= ENC;				//ENABLE ADC
+      ADC12CTL0 |= ADC12SC;			//START SEQUENCE
+      vLIGHT_WaitForSamples(unNext);
+    }
+  }
+
+  ADC12IE &= ~unEndBit;				//disable interupt
+  ADC12CTL0 &= ~(ENC | MSC);
+  ADC12CTL1 &= ~CONSEQ_3;
+  vADC12_ConfigMemCtl();			//restore channel mapping
+}
+
+//!
+//! \brief Reduces the sorted raw block to its robust estimate.
+//!
+//! Sorts g_unaLightBlock with an insertion sort, which needs no extra RAM
+//! and only a few hundred cycles for 16 samples, then returns the median
+//! or trimmed mean in Q4 so that no fraction is lost before averaging.
+//!
+static uint16 unLIGHT_FilterBlock(void)
+{
+  uint8 ucIdx;
+  uint8 ucPos;
+  uint16 unSample;
+  uint16 unSum;
+
+  for (ucIdx = 1; ucIdx < ADC12_NUM_MEM; ucIdx++)
+  {
+    unSample = g_unaLightBlock[ucIdx];
+    for (ucPos = ucIdx; ucPos > 0 && g_unaLightBlock[ucPos - 1] > unSample; ucPos--)
+      g_unaLightBlock[ucPos] = g_unaLightBlock[ucPos - 1];
+    g_unaLightBlock[ucPos] = unSample;
+  }
+
+  if (g_ucLightFilter == LIGHT_FILTER_MEDIAN)
+    return (g_unaLightBlock[7] + g_unaLightBlock[8]) << 3;
+
+  //8 samples remain, twice their sum is their mean in Q4
+  unSum = 0;
+  for (ucIdx = LIGHT_TRIM_SAMPLES; ucIdx < ADC12_NUM_MEM - LIGHT_TRIM_SAMPLES; ucIdx++)
+    unSum += g_unaLightBlock[ucIdx];
+
+  return unSum << 1;
+}
+
+//!
+//! \brief Accumulates robust block estimates of one channel.
+//!
+//! Every ADC12MEMx register is pointed at the channel and one sequence
+//! fills all 16 of them. The ISR only wakes the CPU, the block is copied
+//! to RAM and filtered here before the next block is started.
+//!
+//! \param ucIdx	Index of the channel.
+//! \param unCount	Number of samples requested, rounded up to blocks.
+//!
+static void vLIGHT_RunFiltered(uint8 ucIdx, uint16 unCount)
 {
+  volatile uint16 * punMem;
+  uint16 unBlocks;
+  uint8 ucMem;
+
+  g_pulLightBlockAcc = 0;			//ISR does not accumulate
+  g_unLightTarget = ADC12_NUM_MEM;
+
+  ADC12CTL1 &= ~(CSTARTADD_15 | CONSEQ_3);	//START ADDRESS A0
+  vADC12_ConfigBlock(g_saLightChannels[ucIdx].ucInput);	//ALL 16 MEMS ON THIS CHANNEL
+  ADC12CTL0 |= MSC;				//CONVERT BACK TO BACK
+  ADC12IFG = 0;					//CLEAR FLAGS INSURE
+  ADC12IE |= BITF;				//interupt once per block
+
+  if (g_unLightTriggerTicks)
+    vLIGHT_StartTrigger();		//EVENLY SPACED SAMPLES WITHIN A BLOCK
+
+  for (unBlocks = unLIGHT_BlockCount(unCount); unBlocks > 0; unBlocks--)
+  {
+    g_uiCounter = 0;
+    ADC12CTL1 |= CONSEQ_1;			//ISR CLEARS IT TO STOP
+    if (g_unLightTriggerTicks)
+      ADC12CTL0 |= ENC;				//TIMER STARTS SAMPLES
+    else
+      ADC12CTL0 |= ENC | ADC12SC;	//START BLOCK
+    vLIGHT_WaitForSamples(ADC12_NUM_MEM);
+
+    punMem = &ADC12MEM0;
+    for (ucMem = 0; ucMem < ADC12_NUM_MEM; ucMem++)
+      g_unaLightBlock[ucMem] = *punMem++;
+
+    g_ulaLightAcc[ucIdx] += unLIGHT_FilterBlock();
+  }
+
+  if (g_unLightTriggerTicks)
+    vLIGHT_StopTrigger((uint32)unLIGHT_BlockCount(unCount) * ADC12_NUM_MEM);
+
+  ADC12IE &= ~BITF;				//disable interupt MEM15
+  ADC12CTL0 &= ~MSC;
+  vADC12_ConfigMemCtl();			//restore channel mapping
+}
 
-  //needed for all channel readings
+//!
+//! \brief Accumulates a whole number of 16 sample blocks of one channel.
+//!
+//! Every ADC12MEMx register is pointed at the channel and the ADC runs a
+//! repeat sequence (CONSEQ_3, MSC, or one conversion per Timer B trigger).
+//! The ISR sums each block on the MEM15 interrupt and only wakes the CPU
+//! after the last block.
+//!
+//! \param ucIdx	Index of the channel.
+//! \param unCount	Number of samples, a multiple of 16.
+//!
+static void vLIGHT_RunBlocks(uint8 ucIdx, uint16 unCount)
+{
   g_uiCounter = 0;
+  g_unLightTarget = unCount;
+  g_pulLightBlockAcc = &g_ulaLightAcc[ucIdx];
 
-  //insert 17ms delay here using TIMER B
-  TBCTL |= CNTL_0;					//16-BIT MAX 0FFFFXh
-  TBCTL |= TBSSEL1;					//SOURCE SMCLK
-  TBCTL &= ~TBSSEL0;				//SOURCE SMCLK
-  TBCTL |= ID_1;					//DIVIDER TO 2
-  TBCCR0 = 0X84D0;					//COUNT UP VALUE 34K CYCLES
-  TBCTL |= MC_1;					//UP MODE
+  ADC12CTL1 &= ~(CSTARTADD_15 | CONSEQ_3);	//START ADDRESS A0
+  vADC12_ConfigBlock(g_saLightChannels[ucIdx].ucInput);	//ALL 16 MEMS ON THIS CHANNEL
+  ADC12CTL1 |= CONSEQ_3;			//REPEAT SEQUENCE
+  ADC12CTL0 |= MSC;				//CONVERT BACK TO BACK
+  ADC12IFG = 0;					//CLEAR FLAGS INSURE
+  ADC12IE |= BITF;				//interupt once per block
+
+  if (g_unLightTriggerTicks)
+  {
+    vLIGHT_StartTrigger();
+    ADC12CTL0 |= ENC;				//TIMER STARTS SAMPLES
+    vLIGHT_WaitForSamples(unCount);
+    vLIGHT_StopTrigger(unCount);
+  }
+  else
+  {
+    ADC12CTL0 |= ENC | ADC12SC;		//START FIRST BLOCK
+    vLIGHT_WaitForSamples(unCount);
+  }
+
+  ADC12IE &= ~BITF;				//disable interupt MEM15
+  ADC12CTL0 &= ~MSC;
+  vADC12_ConfigMemCtl();			//restore channel mapping
+}
+
+//!
+//! \brief Accumulates as many blocks of one channel as its noise needs.
+//!
+//! The pilot block stays in ADC12MEM0-15 after vLIGHT_RunBlocks(), its sum
+//! of squared deviations S gives the sample variance S / 15. A mean of N
+//! samples has a standard error within the target t (Q4) once
+//! N >= 256 S / (15 t^2), which is rounded up to whole blocks and kept
+//! within the bounds. The single division is paid once per read.
+//!
+//! \param ucIdx	Index of the channel.
+//! \return Number of samples accumulated.
+//!
+static uint16 unLIGHT_RunAdaptive(uint8 ucIdx)
+{
+  volatile uint16 * punMem;
+  uint32 ulDev;
+  uint32 ulDen;
+  uint32 ulCount;
+  uint16 unMean;
+  uint16 unDiff;
+  uint16 unCount;
+  uint8 ucMem;
+
+  vLIGHT_RunBlocks(ucIdx, ADC12_NUM_MEM);	//pilot block
+  unMean = (uint16)((g_ulaLightAcc[ucIdx] + (ADC12_NUM_MEM >> 1)) >> 4);
+
+  ulDev = 0;
+  punMem = &ADC12MEM0;
+  for (ucMem = 0; ucMem < ADC12_NUM_MEM; ucMem++)
+  {
+    unDiff = *punMem++;
+    unDiff = (unDiff > unMean) ? unDiff - unMean : unMean - unDiff;
+    ulDev = ulFIXMATH_MacSat(ulDev, unDiff, unDiff);
+  }
+
+  //256 S overflows only for noise no target can be met at
+  if (ulDev > 0x00FFFFFF)
+    ulCount = g_unLightAdaptMax;
+  else
+  {
+    //the target can change with every command, one divide per read
+    //against the blocks it sizes
+    ulDen = ulFIXMATH_MulU16(g_ucLightNoiseQ4, (uint16)g_ucLightNoiseQ4 * 15);
+    ulCount = ((ulDev << 8) + ulDen - 1) / ulDen;
+  }
+
+  if (ulCount < g_unLightAdaptMin)
+    ulCount = g_unLightAdaptMin;
+  if (ulCount > g_unLightAdaptMax)
+    ulCount = g_unLightAdaptMax;
+  unCount = ((uint16)ulCount + ADC12_NUM_MEM - 1) & ~(ADC12_NUM_MEM - 1);
+
+  if (unCount > ADC12_NUM_MEM)
+    vLIGHT_RunBlocks(ucIdx, unCount - ADC12_NUM_MEM);
+
+  return unCount;
+}
+
+//!
+//! \brief Converts channels on two op-amp groups with overlapped settling.
+//!
+//! The first group is converted as soon as its amp has settled while the
+//! amp of the second group settles in parallel. The second amp is switched
+//! on so that it becomes ready just as the first group finishes, using the
+//! conversion time of the previous pipelined read, and the first amp is
+//! switched off as soon as its channels are done. A read of all four
+//! channels then costs about one settle delay plus the conversions, with
+//! each amp powered only while it is needed. The timing of every phase is
+//! kept for unLIGHT_GetPhaseTicks().
+//!
+//! \param ucFirst	Channels of the first amp group.
+//! \param ucSecond	Channels of the other amps.
+//! \param ucRefs	Non zero to append the reference channels to the second group.
+//! \param unCount	Number of sequences.
+//!
+static void vLIGHT_RunPipelined(uint8 ucFirst, uint8 ucSecond, uint8 ucRefs, uint16 unCount)
+{
+  uint8 ucAmp1;
+  uint8 ucAmp2;
+  uint16 unSettle1;
+  uint16 unSettle2;
+  uint16 unLead;
+  uint16 unOnTicks;
+
+  unSettle1 = unLIGHT_GroupSettle(ucFirst, &ucAmp1);
+  unSettle2 = unLIGHT_GroupSettle(ucSecond, &ucAmp2);
+
+  //time the second amp needs before the first group has converted
+  unLead = 0;
+  if (unSettle2 > g_unLightFirstConvTicks)
+    unLead = unSettle2 - g_unLightFirstConvTicks;
+
+  //phase 1: first amp settles, second amp joins unLead ticks before the end
+  if (unLead >= unSettle1)
+  {
+    unLead = unSettle1;
+    P_AMP_EN_OUT &= ~(ucAmp1 | ucAmp2);	//enable both opAmps
+    if (unSettle1)
+      vLIGHT_SettleDelay(unSettle1);
+  }
+  else
+  {
+    P_AMP_EN_OUT &= ~ucAmp1;			//enable first opAmp
+    vLIGHT_SettleDelay(unSettle1 - unLead);
+    P_AMP_EN_OUT &= ~ucAmp2;			//enable second opAmp
+    if (unLead)
+      vLIGHT_SettleDelay(unLead);
+  }
+  g_unaLightPhaseTicks[LIGHT_PHASE_SETTLE] = unSettle1;
+
+  //phase 2: first group converts while the second amp settles
+  vLIGHT_StartStopwatch();
+  vLIGHT_RunSequence(ucFirst, 0, unCount);
+  g_unLightFirstConvTicks = unLIGHT_StopwatchTicks();
+  if (!g_ucLightHold)
+    P_AMP_EN_OUT |= ucAmp1 & ~ucAmp2;	//first opAmp done
+  g_unaLightPhaseTicks[LIGHT_PHASE_FIRST] = g_unLightFirstConvTicks;
 
-  while(!(TBCTL & TBIFG));			//DELAY UNTIL IFG THROWN
-  TBCTL &= ~(TBIFG | MC0 | MC1);	//CLEAR B TIMER
-  P_AMP_EN_OUT &= ~AMP2_EN;			//enable opAmp channels A2/A3
+  //phase 3: whatever settle time of the second amp is left
+  unOnTicks = unLead + g_unLightFirstConvTicks;
+  if (unOnTicks < unLead)				//saturate
+    unOnTicks = 0xFFFF;
+  g_unaLightPhaseTicks[LIGHT_PHASE_WAIT] = 0;
+  if (unSettle2 > unOnTicks)
+  {
+    g_unaLightPhaseTicks[LIGHT_PHASE_WAIT] = unSettle2 - unOnTicks;
+    vLIGHT_SettleDelay(unSettle2 - unOnTicks);
+  }
 
-  g_unADChannelA4 = 0;				//reset variables
-  g_unActiveChannelRequest = 4;		//channel 4 request
+  //phase 4: second group, with the references
+  vLIGHT_StartStopwatch();
+  vLIGHT_RunSequence(ucSecond, ucRefs, unCount);
+  g_unaLightPhaseTicks[LIGHT_PHASE_SECOND] = unLIGHT_StopwatchTicks();
+}
 
-  ADC12CTL1 |= CSTARTADD_3;			//SET ADD TO A3
-  ADC12IE |= BIT3;					//set interupts on A3
-  ADC12IFG &= ~BIT3;				//CLEAR FLAG INSURE
+//!
+//! \brief Refreshes the dark offset models of a read.
+//!
+//! Converts the temperature sensor every LIGHT_TEMP_READS reads, or at
+//! once when a channel of the read has no offset yet. A channel is stale
+//! without an offset, or once the temperature left the span of its model:
+//! LIGHT_DARK_TEMP_STEP for a single offset, LIGHT_DARK_MODEL_SPAN with a
+//! slope. Only stale channels are converted with their op-amps off, after
+//! the settle delay of the channels, so the offset holds the amplifier
+//! output in the dark state. The new offset and the old one, when taken
+//! at least LIGHT_DARK_TEMP_STEP apart, give the slope of the channel.
+//! Runs with the ADC on and ENC clear.
+//!
+//! \param ucMask	Channels of the read, bit 0 is channel 1.
+//! \return AMPx_EN bits of the op-amps switched off.
+//!
+static uint8 ucLIGHT_UpdateDark(uint8 ucMask)
+{
+  uint8 ucIdx;
+  uint8 ucBit;
+  uint8 ucStale;
+  uint8 ucAmps;
+  uint16 unOffset;
+  uint16 unSpan;
+  uint16 unTicks;
+  int32 lDelta;
+  int32 lSlope;
 
-  while(g_uiCounter < *punAvgCount)
+  if (++g_ucLightTempAge >= LIGHT_TEMP_READS || (ucMask & ~g_ucLightDarkValid))
   {
-  ADC12CTL0 |= ENC;					//ENABLE ADC
-  ADC12CTL0 |= ADC12SC;				//ENABLE ADC12 START SAMPLE
-  __bis_SR_register(GIE + LPM0_bits);
+    g_ulLightTempAcc = 0;
+    vLIGHT_RunSequence(0, LIGHT_SEQ_TEMP, LIGHT_TEMP_SAMPLES);
+    g_unLightTempQ4 = (uint16)ulFIXMATH_Average(g_ulLightTempAcc << 4, LIGHT_TEMP_SAMPLES);
+    g_ucLightTempAge = 0;
+  }
+
+  //the offsets drift with temperature, past its span a model is retaken
+  ucStale = ucMask & ~g_ucLightDarkValid;
+  for (ucIdx = 0; ucIdx < LIGHT_NUM_CHANNELS; ucIdx++)
+  {
+    ucBit = 1 << ucIdx;
+    if (!(ucMask & g_ucLightDarkValid & ucBit))
+      continue;
+
+    unSpan = (g_ucLightDarkSloped & ucBit) ? LIGHT_DARK_MODEL_SPAN : LIGHT_DARK_TEMP_STEP;
+    lDelta = (int32)g_unLightTempQ4 - g_unaLightDarkTempQ4[ucIdx];
+    if (lDelta > unSpan || lDelta < -(int32)unSpan)
+      ucStale |= ucBit;
+  }
+  if (ucStale == 0)
+    return 0;
+
+  //the dark state holds the whole op-amp off, warm or not
+  unLIGHT_GroupSettle(ucStale, &ucAmps);
+  P_AMP_EN_OUT |= ucAmps;			//disable opAmps
+  g_ucLightAmpsWarm &= ~ucAmps;
+  unTicks = unLIGHT_GroupSettle(ucStale, &ucAmps);
+  if (unTicks)
+    vLIGHT_SettleDelay(unTicks);
+
+  for (ucIdx = 0; ucIdx < LIGHT_NUM_CHANNELS; ucIdx++)
+    g_ulaLightAcc[ucIdx] = 0;
+  vLIGHT_RunSequence(ucStale, 0, LIGHT_DARK_SAMPLES);
+
+  for (ucIdx = 0; ucIdx < LIGHT_NUM_CHANNELS; ucIdx++)
+  {
+    ucBit = 1 << ucIdx;
+    if (!(ucStale & ucBit))
+      continue;
+
+    unOffset = (uint16)ulFIXMATH_Average(g_ulaLightAcc[ucIdx] << 4, LIGHT_DARK_SAMPLES);
+
+    //fit the slope across the old offset, the temperature span is measured
+    //so this divide stays, once per retaken offset
+    lDelta = (int32)g_unLightTempQ4 - g_unaLightDarkTempQ4[ucIdx];
+    if ((g_ucLightDarkValid & ucBit)
+        && (lDelta >= LIGHT_DARK_TEMP_STEP || lDelta <= -LIGHT_DARK_TEMP_STEP))
+    {
+      lSlope = (((int32)unOffset - g_unaLightDarkQ4[ucIdx]) << LIGHT_DARK_SLOPE_SHIFT) / lDelta;
+      if (lSlope > 32767)
+        lSlope = 32767;
+      if (lSlope < -32767)
+        lSlope = -32767;
+      g_iaLightDarkSlope[ucIdx] = (int16)lSlope;
+      g_ucLightDarkSloped |= ucBit;
+    }
+
+    g_unaLightDarkQ4[ucIdx] = unOffset;
+    g_unaLightDarkTempQ4[ucIdx] = g_unLightTempQ4;
+  }
+  g_ucLightDarkValid |= ucStale;
+
+  return ucAmps;
+}
+
+//!
+//! \brief Reads any set of light channels.
+//!
+//! Channels behind one op-amp are powered together and the longest settle
+//! delay among them is paid once, then converted as one packed sequence per
+//! trigger. Channels spread over several op-amps are pipelined by
+//! vLIGHT_RunPipelined(). A single channel takes
+//! the hardware block path when the count is a multiple of 16, or the
+//! robust filters when they are selected. With compensation on the
+//! references join the sequence, or follow the block acquisitions as
+//! LIGHT_REF_SAMPLES short sequences.
+//!
+//! \param ucMask		Channels to read, bit 0 is channel 1.
+//! \param punAvgCount	Number of readings to avg. over, 0 or no pointer
+//!						uses the descriptor default.
+//! \param punaResults	Array of four, receives the readings by channel.
+//!						Entries of channels not read are left alone.
+//!
+void vLIGHT_ReadChannels(uint8 ucMask, uint16 * punAvgCount, uint16 * punaResults)
+{
+  uint8 ucIdx;
+  uint8 ucFirst;
+  uint8 ucSecond;
+  uint8 ucAmps;
+  uint8 ucFilter;
+  uint8 ucRefs;
+  uint8 ucOff;
+  uint8 ucAdapt;
+  uint16 unTicks;
+  uint16 unCount;
+  uint16 unRefCount;
+
+  ucMask &= LIGHT_ALL_CHANNELS;
+  if (ucMask == 0)
+    return;
+
+  //channels not behind the op-amp of the first channel form the second group
+  ucFirst = LIGHT_NUM_CHANNELS;
+  ucSecond = 0;
+  for (ucIdx = 0; ucIdx < LIGHT_NUM_CHANNELS; ucIdx++)
+  {
+    if (ucMask & (1 << ucIdx))
+    {
+      if (ucFirst == LIGHT_NUM_CHANNELS)
+        ucFirst = ucIdx;
+      if (g_saLightChannels[ucIdx].ucAmpPin != g_saLightChannels[ucFirst].ucAmpPin)
+        ucSecond |= 1 << ucIdx;
+      g_ulaLightAcc[ucIdx] = 0;		//reset variables
+    }
+  }
+  unTicks = unLIGHT_GroupSettle(ucMask, &ucAmps);
+
+  //amps held warm from an earlier read need neither settling nor pipelining
+  if (!(ucAmps & ~g_ucLightAmpsWarm))
+    ucSecond = 0;
+  g_ulaLightRef[0] = 0;
+  g_ulaLightRef[1] = 0;
+  g_ulaLightRef[2] = 0;
+
+  //the robust filters and the block path need a single channel
+  ucFilter = LIGHT_FILTER_MEAN;
+  if (!(ucMask & (ucMask - 1)))
+    ucFilter = g_ucLightFilter;
+  ucRefs = 0;
+  if (g_ucLightComp != LIGHT_COMP_OFF)
+    ucRefs = LIGHT_SEQ_REFS;
+  unCount = unLIGHT_SampleCount(punAvgCount, ucFirst);
+  unRefCount = unCount;
+
+  //the count of a plain single channel read can follow its noise
+  ucAdapt = (g_ucLightNoiseQ4 && ucFilter == LIGHT_FILTER_MEAN && !(ucMask & (ucMask - 1))
+             && !g_ucLightOversample && !g_pucLightCapture);
+  g_unLightAdaptCount = 0;
+
+  g_unaLightPhaseTicks[LIGHT_PHASE_WAIT] = 0;
+  g_unaLightPhaseTicks[LIGHT_PHASE_SECOND] = 0;
+
+  if (ucSecond)
+  {
+    vLIGHT_RunPipelined(ucMask & ~ucSecond, ucSecond, ucRefs, unCount);
+  }
+  else
+  {
+    P_AMP_EN_OUT &= ~ucAmps;			//enable opAmps
+
+    //let the reference and op-amps settle, sleeping in LPM0
+    if (unTicks)
+      vLIGHT_SettleDelay(unTicks);
+    g_unaLightPhaseTicks[LIGHT_PHASE_SETTLE] = unTicks;
+
+    vLIGHT_StartStopwatch();
+    if (ucFilter != LIGHT_FILTER_MEAN || ucAdapt
+        || (!(ucMask & (ucMask - 1)) && !(unCount & (ADC12_NUM_MEM - 1))))
+    {
+      if (ucFilter != LIGHT_FILTER_MEAN)
+        vLIGHT_RunFiltered(ucFirst, unCount);
+      else if (ucAdapt)
+        unCount = g_unLightAdaptCount = unLIGHT_RunAdaptive(ucFirst);
+      else
+        vLIGHT_RunBlocks(ucFirst, unCount);
+
+      //references in their own sequences while the amps are still on
+      if (ucRefs)
+      {
+        vLIGHT_RunSequence(0, LIGHT_SEQ_REFS, LIGHT_REF_SAMPLES);
+        unRefCount = LIGHT_REF_SAMPLES;
+      }
+    }
+    else
+    {
+      vLIGHT_RunSequence(ucMask, ucRefs, unCount);
+    }
+    g_unaLightPhaseTicks[LIGHT_PHASE_FIRST] = unLIGHT_StopwatchTicks();
   }
 
-  ADC12IE &= ~BIT3;					//disable interupt A0
   ADC12CTL0 &= ~ENC;				//disable ADC
-  ADC12CTL0 &= ~ADC12ON;			//turn off ADC
-
-  P_AMP_EN_OUT |= AMP2_EN;			//disable opAmp channels A2/A3
-  return g_unADChannelA4 /= *punAvgCount;
-}
-
-//uint16 unLIGHT_ReadChannel_Ref(uint16 * punDummy1, uint16 * punDummy2)
-//{
-  //needed for all channel readings
-  //g_uiCounter = 0;
-  //P5OUT &= ~BIT0;					//enable VREF
-  //ADC12CTL0 |= ADC12ON;			//TURN ON ADC
-  //insert 17ms delay here using TIMER B
-  //TBCTL |= CNTL_0;				//16-BIT MAX 0FFFFXh
-  //TBCTL |= TBSSEL1;				//SOURCE SMCLK
-  //TBCTL &= ~TBSSEL0;				//SOURCE SMCLK
-  //TBCTL |= ID_1;					//DIVIDER TO 2
-  //TBCCR0 = 0X84D0;				//COUNT UP VALUE 34K CYCLES
-  //TBCTL |= MC_1;					//UP MODE
-  
-  //while(!(TBCTL & TBIFG));		//DELAY UNTIL IFG THROWN
-  //TBCTL &= ~(TBIFG | MC0 | MC1);	//CLEAR B TIMER
-    
-  //g_unADChannelA5 = 0;			//reset variables
-    
-  //ADC12CTL1 |= CSTARTADD_4;		//SET ADD TO A4
-  //ADC12IE |= BIT4; 				//set interupts on A4
-  //ADC12IFG &= ~BIT4;				//CLEAR FLAG INSURE
-  
-  //ADC12CTL0 |= ENC;				//ENABLE ADC  	
-  //ADC12CTL0 |= ADC12SC;			//ENABLE ADC12 START SAMPLE
-    
-  //__bis_SR_register(GIE + LPM0_bits);
-  
-  //ADC12IE &= ~BIT4;				//disable interupt A4
-  //ADC12CTL0 &= ~ENC;				//disable ADC
-  //ADC12CTL0 &= ~ADC12ON;			//turn off ADC
-  //P5OUT |= BIT0;					//disable VREF
-  //return g_unADChannelA5;
-  
-//}
-
-//uint16 unLIGHT_ReadChannel_NegRef(uint16 * punDummy1, uint16 * punDummy2)
-//{
-  //needed for all channel readings
-  //g_uiCounter = 0;
-  //P5OUT &= ~BIT0;					//enable VREF
-  //ADC12CTL0 |= ADC12ON;			//TURN ON ADC
-  //insert 17ms delay here using TIMER B
-  //TBCTL |= CNTL_0;				//16-BIT MAX 0FFFFXh
-  //TBCTL |= TBSSEL1;				//SOURCE SMCLK
-  //TBCTL &= ~TBSSEL0;				//SOURCE SMCLK
-  //TBCTL |= ID_1;					//DIVIDER TO 2
-  //TBCCR0 = 0X84D0;				//COUNT UP VALUE 34K CYCLES
-  //TBCTL |= MC_1;					//UP MODE
-  
-  //while(!(TBCTL & TBIFG));		//DELAY UNTIL IFG THROWN
-  //TBCTL &= ~(TBIFG | MC0 | MC1);	//CLEAR B TIMER
-    
-  //g_unADChannelA5 = 0;			//reset variables
-    
-  //ADC12CTL1 |= CSTARTADD_5;		//SET ADD TO A5
-  //ADC12IE |= BIT5; 				//set interupts on A5
-  //ADC12IFG &= ~BIT5;				//CLEAR FLAG INSURE
-  
-  //ADC12CTL0 |= ENC;				//ENABLE ADC  	
-  //ADC12CTL0 |= ADC12SC;			//ENABLE ADC12 START SAMPLE
-    
-  //__bis_SR_register(GIE + LPM0_bits);
-  
-  //ADC12IE &= ~BIT5;				//disable interupt A5
-  //ADC12CTL0 &= ~ENC;				//disable ADC
-  //ADC12CTL0 &= ~ADC12ON;			//turn off ADC
-  //P5OUT |= BIT0;					//disable VREF
-  //return g_unADChannelA6;
-  
-//}
-
-//uint16 unLIGHT_ReadChannel_Avdd(uint16 * punDummy1, uint16 * punDummy2)
-//{
-  //needed for all channel readings
-  //g_uiCounter = 0;
-  //P5OUT &= ~BIT0;					//enable VREF
-  //ADC12CTL0 |= ADC12ON;			//TURN ON ADC
-  //insert 17ms delay here using TIMER B
-  //TBCTL |= CNTL_0;				//16-BIT MAX 0FFFFXh
-  //TBCTL |= TBSSEL1;				//SOURCE SMCLK
-  //TBCTL &= ~TBSSEL0;				//SOURCE SMCLK
-  //TBCTL |= ID_1;					//DIVIDER TO 2
-  //TBCCR0 = 0X84D0;				//COUNT UP VALUE 34K CYCLES
-  //TBCTL |= MC_1;					//UP MODE
-  
-  //while(!(TBCTL & TBIFG));		//DELAY UNTIL IFG THROWN
-  //TBCTL &= ~(TBIFG | MC0 | MC1);	//CLEAR B TIMER
-    
-  //g_unADChannelA5 = 0;			//reset variables
-    
-  //ADC12CTL1 |= CSTARTADD_6;		//SET ADD TO A6
-  //ADC12IE |= BIT6;				//set interupts on A6
-  //ADC12IFG &= ~BIT6;				//CLEAR FLAG INSURE
-  
-  //ADC12CTL0 |= ENC;				//ENABLE ADC  	
-  //ADC12CTL0 |= ADC12SC;			//ENABLE ADC12 START SAMPLE
-    
-  //__bis_SR_register(GIE + LPM0_bits);
-  
-  //ADC12IE &= ~BIT6;				//disable interupt A6
-  //ADC12CTL0 &= ~ENC;				//disable ADC
-  //ADC12CTL0 &= ~ADC12ON;			//turn off ADC
-  //P5OUT |= BIT0;					//disable VREF
-  //return g_unADChannelA7;
-  
-//}
-
-//void main()
-//{
-//  g_unTest1 = 16; 				//testing purpose only
-//  g_unTest2 = 0;					//testing purpose only
-//
-//  // CHANGES!!!
-//  // Move this core stuff to the changeable_core_header.h in the new core code
-//
-//  // Initilize clocks and core modules
-//  vCORE_Initilize();
-//  vCORE_SetWrapperSoftwareString(g_ucaSoftwareVersion);
-//
-//  P5OUT &= ~BIT2;					//enable opAmp channels A2/A3
-//
-//
-//  P6DIR &= ~BIT1;
-//  P6SEL |= BIT1;
-//  P6DIR &= ~BIT2;
-//  P6SEL |= BIT2;
-//  P6DIR &= ~BIT3;					//set dir port 6.3 (A3)
-//  P6SEL |= BIT3;					//set port 6.3 as periph.
-//  P6DIR &= ~BIT0;					//SET DIR PORT 6.0
-//  P6SEL |= BIT0;					//SET PORT 6.0 AS PERIPH
-//
-//  //g_ulCounter = 0x000FFFFF;		//loop for testing
-//  //while(--g_ulCounter);
-//  //P5OUT |= BIT0 | BIT1 | BIT2;	//sets 5.0/1/2 all high disable MOSFET
-//
-//  // ADC CTL
-//  ADC12CTL0 = 0x0000;				//clear to allow set up of A/D ENC==0
-//
-//  ADC12CTL0 |= SHT0_9;				//SET ADC12CLK TO 384 CYCLES
-//  ADC12CTL0 &= ~REFON;				//CLEAR INTERNAL REF
-//  ADC12CTL1 |= SHS_0;				//ADC12SC BIT FOR SOURCE SELECT
-//  ADC12CTL1 |= SHP;					//SAMPCON sourced from sampling timer
-//  ADC12CTL1 |= (BIT5 | BIT6 | BIT7);//CLOCK DIVIDER TO 8
-//  ADC12CTL1 |= (ADC12SSEL0 | ADC12SSEL1);	//sets SMCLK for clock src sel
-//  ADC12CTL1 &= ~CONSEQ1;			//SINGLE CH
-//  ADC12CTL1 &= ~CONSEQ0;			//SINGLE CONVERT
-//  ADC12CTL0 &= ~MSC;				//clear only used for sequence
-//
-//  // MEM CTL
-//  ADC12MCTL0 |= SREF_2;				//Vr+ = Veref+ and Vr- = AVss
-//  ADC12MCTL0 |= INCH_0;				//SET CH A0
-//  ADC12MCTL1 |= SREF_2;				//Vr+ = Veref+ and Vr- = AVss
-//  ADC12MCTL1 |= INCH_1;				//SET CH A1
-//  ADC12MCTL2 |= SREF_2;				//Vr+ = Veref+ and Vr- = AVss
-//  ADC12MCTL2 |= INCH_2;				//SET CH A2
-//  ADC12MCTL3 |= SREF_2;				//Vr+ = Veref+ and Vr- = AVss
-//  ADC12MCTL3 |= INCH_3;				//SET CH A3
-//  ADC12MCTL4 |= SREF_2;				//Vr+ = Veref+ and Vr- = AVss
-//  ADC12MCTL4 |= INCH_8;				//SET CH VEREF+
-//  ADC12MCTL5 |= SREF_2;				//Vr+ = Veref+ and Vr- = AVss
-//  ADC12MCTL5 |= INCH_9;				//SET -REF
-//  ADC12MCTL6 |= SREF_2;				//Vr+ = Veref+ and Vr- = AVss
-//  ADC12MCTL6 |= INCH_11;			//SET AVDD
-//
-//  //vCORE_Run();
-//  //unLIGHT_ReadChannel_1( &g_unTest1, &g_unTest2 );
-//  unLIGHT_ReadChannel_2( &g_unTest1, &g_unTest2 );
-//  //unLIGHT_ReadChannel_3( &g_unTest1, &g_unTest2 );
-//  //unLIGHT_ReadChannel_4( &g_unTest1, &g_unTest2 );
-//  while(1);
-//}
-
-//!
-//! \brief Takes reading from requested channel and stores into var.
-//!
-//! Uses g_unActiveChannelRequest to verify which channel to read
-//! then takes the reading from requested channel and stores the 
-//! value into the variable for that channel. (IE g_unADChannelA1)
-//! Then returns from ISR in active mode.
+
+  //reduce before the accumulators are reused for the dark offsets
+  for (ucIdx = 0; ucIdx < LIGHT_NUM_CHANNELS; ucIdx++)
+  {
+    if (ucMask & (1 << ucIdx))
+      punaResults[ucIdx] = unLIGHT_Reduce(g_ulaLightAcc[ucIdx], unCount, ucFilter);
+  }
+
+  //dark offsets are taken while the ADC and reference are still up
+  ucOff = 0;
+  if (g_ucLightDark && !g_pucLightCapture)
+    ucOff = ucLIGHT_UpdateDark(ucMask);
+
+  //a held front end keeps the ADC and the settled amps on for the next read
+  if (g_ucLightHold)
+  {
+    g_ucLightAmpsWarm |= ucAmps & ~ucOff;
+  }
+  else
+  {
+    ADC12CTL0 &= ~ADC12ON;			//turn off ADC
+    P_AMP_EN_OUT |= ucAmps;			//disable opAmps
+  }
+
+  //reference averages in Q4 of the 12 bit scale
+  for (ucIdx = 0; ucIdx < 3; ucIdx++)
+    g_unaLightRefQ4[ucIdx] = (uint16)ulFIXMATH_Average(g_ulaLightRef[ucIdx] << 4, unRefCount);
+  if (ucRefs)
+    vLIGHT_UpdateCompScale();
+
+  for (ucIdx = 0; ucIdx < LIGHT_NUM_CHANNELS; ucIdx++)
+  {
+    if (ucMask & (1 << ucIdx))
+      punaResults[ucIdx] = unLIGHT_Compensate(punaResults[ucIdx], ucIdx);
+  }
+}
+
+//!
+//! \brief Reads one light channel.
+//!
+//! \param ucChannel	Light channel (1-4).
+//! \param punAvgCount	Number of readings to avg. over, 0 or no pointer
+//!						uses the descriptor default.
+//! \return The reading, 0 for an invalid channel.
+//!
+uint16 unLIGHT_ReadChannel(uint8 ucChannel, uint16 * punAvgCount)
+{
+  uint16 unaResults[LIGHT_NUM_CHANNELS];
+
+  if (ucChannel == 0 || ucChannel > LIGHT_NUM_CHANNELS)
+    return 0;
+
+  vLIGHT_ReadChannels(1 << (ucChannel - 1), punAvgCount, unaResults);
+  return unaResults[ucChannel - 1];
+}
+
+//!
+//! \brief Records raw samples of one channel.
+//!
+//! The samples are taken by the block path, back to back or at the timer
+//! triggered rate, and the ISR packs every block into the capture buffer
+//! as it completes. Oversampling, filters and compensation are suspended
+//! for the capture.
+//!
+//! \param ucChannel	Light channel (1-4).
+//! \param unSamples	Number of samples, rounded up to 16 and limited to
+//!						LIGHT_CAPTURE_LEN.
+//! \return Number of samples captured, 0 for an invalid channel.
+//!
+uint16 unLIGHT_Capture(uint8 ucChannel, uint16 unSamples)
+{
+  uint16 unaResults[LIGHT_NUM_CHANNELS];
+  uint8 ucOversample;
+  uint8 ucFilter;
+  uint8 ucComp;
+
+  if (ucChannel == 0 || ucChannel > LIGHT_NUM_CHANNELS)
+    return 0;
+
+  //whole blocks that fit the buffer
+  if (unSamples == 0 || unSamples > LIGHT_CAPTURE_LEN)
+    unSamples = LIGHT_CAPTURE_LEN;
+  unSamples = (unSamples + ADC12_NUM_MEM - 1) & ~(ADC12_NUM_MEM - 1);
+
+  ucOversample = g_ucLightOversample;
+  ucFilter = g_ucLightFilter;
+  ucComp = g_ucLightComp;
+  g_ucLightOversample = 0;
+  g_ucLightFilter = LIGHT_FILTER_MEAN;
+  g_ucLightComp = LIGHT_COMP_OFF;
+
+  g_pucLightCapture = g_ucaLightCapture;
+  vLIGHT_ReadChannels(1 << (ucChannel - 1), &unSamples, unaResults);
+  g_pucLightCapture = 0;
+
+  g_ucLightOversample = ucOversample;
+  g_ucLightFilter = ucFilter;
+  g_ucLightComp = ucComp;
+
+  return unSamples;
+}
+
+//!
+//! \brief Returns the packed samples of the last capture.
+//!
+uint8 * pucLIGHT_GetCapture(void)
+{
+  return g_ucaLightCapture;
+}
+
+//!
+//! \brief Returns one sample of the packed capture buffer.
+//!
+static uint16 unLIGHT_CaptureSample(uint16 unIdx)
+{
+  uint8 * pucPair;
+
+  pucPair = &g_ucaLightCapture[(unIdx >> 1) * 3];
+  if (unIdx & 1)
+    return ((uint16)(pucPair[1] & 0x0F) << 8) | pucPair[2];
+
+  return ((uint16)pucPair[0] << 4) | (pucPair[1] >> 4);
+}
+
+//!
+//! \brief Integer square root.
+//!
+static uint16 unLIGHT_Sqrt(uint32 ulX)
+{
+  uint32 ulBit;
+  uint32 ulRoot;
+
+  ulRoot = 0;
+  ulBit = 0x40000000;
+  while (ulBit > ulX)
+    ulBit >>= 2;
+
+  while (ulBit)
+  {
+    if (ulX >= ulRoot + ulBit)
+    {
+      ulX -= ulRoot + ulBit;
+      ulRoot = (ulRoot >> 1) + ulBit;
+    }
+    else
+    {
+      ulRoot >>= 1;
+    }
+    ulBit >>= 2;
+  }
+
+  return (uint16)ulRoot;
+}
+
+//!
+//! \brief Returns the magnitude of one frequency of the capture.
+//!
+//! Goertzel filter over the mean free samples, states in 32 bits and the
+//! coefficient in Q14. The states are scaled below 2^14 before the power
+//! s1^2 + s2^2 - c s1 s2 is formed, so every product fits the multiplier.
+//!
+//! \param iCoef	2cos(2 pi f / fs) in Q14.
+//! \param unMean	Mean of the samples.
+//! \param unCount	Number of samples.
+//! \return |X(f)|, a sinusoid of amplitude A gives A * unCount / 2.
+//!
+static uint32 ulLIGHT_Goertzel(int16 iCoef, uint16 unMean, uint16 unCount)
+{
+  int32 lS0;
+  int32 lS1;
+  int32 lS2;
+  int32 lPower;
+  uint16 unIdx;
+  uint8 ucShift;
+
+  lS1 = 0;
+  lS2 = 0;
+  for (unIdx = 0; unIdx < unCount; unIdx++)
+  {
+    lS0 = (int16)(unLIGHT_CaptureSample(unIdx) - unMean) + lFIXMATH_MulQ14(iCoef, lS1) - lS2;
+    lS2 = lS1;
+    lS1 = lS0;
+  }
+
+  ucShift = 0;
+  while (lS1 >= 0x4000 || lS1 < -0x4000 || lS2 >= 0x4000 || lS2 < -0x4000)
+  {
+    lS1 >>= 1;
+    lS2 >>= 1;
+    ucShift++;
+  }
+
+  lPower = lFIXMATH_MulS16((int16)lS1, (int16)lS1) + lFIXMATH_MulS16((int16)lS2, (int16)lS2)
+           - lFIXMATH_MulS16((int16)lFIXMATH_MulQ14(iCoef, lS1), (int16)lS2);
+  if (lPower < 0)
+    lPower = 0;
+
+  return (uint32)unLIGHT_Sqrt((uint32)lPower) << ucShift;
+}
+
+//!
+//! \brief Measures the flicker of one channel.
+//!
+//! Takes a full capture at LIGHT_FLICKER_HZ, replacing the contents of the
+//! capture buffer, and reduces it to the report described in light.h.
+//! Percent modulation is 100 (max - min) / (max + min), the flicker index
+//! the area above the mean over the total area.
+//!
+//! \param ucChannel	Light channel (1-4).
+//! \param pucReport	Receives LIGHT_FLICKER_REPORT_LEN bytes.
+//! \return 1 on success, 0 for an invalid channel.
+//!
+uint8 ucLIGHT_AnalyzeFlicker(uint8 ucChannel, uint8 * pucReport)
+{
+  uint32 ulSum;
+  uint32 ulAbove;
+  uint32 ulPercent;
+  uint16 unTriggerTicks;
+  uint16 unCount;
+  uint16 unIdx;
+  uint16 unSample;
+  uint16 unMean;
+  uint16 unMin;
+  uint16 unMax;
+  uint32 ulMag;
+  uint32 ulBestMag;
+  uint8 ucBin;
+  uint8 ucBest;
+
+  unTriggerTicks = g_unLightTriggerTicks;
+  vLIGHT_SetSampleRate(LIGHT_FLICKER_HZ);
+  unCount = unLIGHT_Capture(ucChannel, LIGHT_CAPTURE_LEN);
+  g_unLightTriggerTicks = unTriggerTicks;
+
+  if (unCount == 0)
+    return 0;
+
+  ulSum = 0;
+  unMin = 0xFFFF;
+  unMax = 0;
+  for (unIdx = 0; unIdx < unCount; unIdx++)
+  {
+    unSample = unLIGHT_CaptureSample(unIdx);
+    ulSum += unSample;
+    if (unSample < unMin)
+      unMin = unSample;
+    if (unSample > unMax)
+      unMax = unSample;
+  }
+  unMean = (uint16)ulFIXMATH_Average(ulSum, unCount);
+
+  if (ulSum == 0)
+  {
+    pucReport[0] = 0;
+    pucReport[1] = 0;
+    pucReport[2] = LIGHT_FLICKER_NONE;
+    pucReport[3] = 0;
+    return 1;
+  }
+
+  ulAbove = 0;
+  for (unIdx = 0; unIdx < unCount; unIdx++)
+  {
+    unSample = unLIGHT_CaptureSample(unIdx);
+    if (unSample > unMean)
+      ulAbove += unSample - unMean;
+  }
+
+  //three divides per analysis, against the Goertzel passes over the
+  //whole capture they are noise
+  pucReport[0] = (uint8)((100UL * (unMax - unMin)) / ((uint32)unMax + unMin));
+  pucReport[1] = (uint8)((100UL * ulAbove) / ulSum);
+
+  //strongest mains component, amplitude 2 |X| / N in percent of the mean
+  ucBest = 0;
+  ulBestMag = 0;
+  for (ucBin = 0; ucBin < LIGHT_FLICKER_BINS; ucBin++)
+  {
+    ulMag = ulLIGHT_Goertzel(g_iaLightGoertzelCoef[ucBin], unMean, unCount);
+    if (ulMag > ulBestMag)
+    {
+      ulBestMag = ulMag;
+      ucBest = ucBin;
+    }
+  }
+
+  ulPercent = (200UL * ulBestMag) / ulSum;
+  if (ulPercent > 0xFF)
+    ulPercent = 0xFF;
+
+  pucReport[2] = ucBest;
+  pucReport[3] = (uint8)ulPercent;
+  return 1;
+}
+
+//!
+//! \brief Adds finished conversions to their accumulators.
+//!
+//! A MEM15 interrupt ends a 16 sample block, which is packed into the
+//! capture buffer while capturing, summed into g_pulLightBlockAcc (if set)
+//! and stops the ADC once the target count is reached. Any other
+//! interrupt ends a packed sequence: every register is added to the
+//! accumulator recorded for it, without testing which channels are being
+//! read, and the ADC stops after the target number of sequences. Returns
+//! from the ISR in active mode.
 //!
 #pragma vector = ADC12_VECTOR
 __interrupt void ADCConversion(void)
 {
-  switch(g_unActiveChannelRequest)
-  {
-  case 1:
-    g_unADChannelA1 += ADC12MEM0;	//READS CHANNEL 0 TO GLOBAL VARIABLE
-    break;	
-  case 2:	
-    g_unADChannelA2 += ADC12MEM1;	//READS CHANNEL 1 TO GLOBAL VARIABLE
-    break;
-  case 3:
-    g_unADChannelA3 += ADC12MEM2;	//READS CHANNEL 2 TO GLOBAL VARIABLE
-    break;
-  case 4:
-    g_unADChannelA4 += ADC12MEM3;	//READS CHANNEL 3 TO GLOBAL VARIABLE
-    break;
-  default: break;					//no valid request
-  }		
-  
-  //g_unADChannelA5 = ADC12MEM4;
-  //g_unADChannelA6 = ADC12MEM5;
-  //g_unADChannelA7 = ADC12MEM6;
-  			
+  volatile uint16 * punMem;
+  uint32 ** ppulAcc;
+  uint16 unBlockSum;
+  uint16 unFirst;
+  uint16 unSecond;
+  uint8 ucIdx;
+
+  punMem = &ADC12MEM0;
+
+  //a block has filled ADC12MEM0-15, sum the whole block
+  if (ADC12IV == ADC12_IV_MEM15)
+  {
+    //pack two samples in three bytes, the next sample takes a whole
+    //conversion time so the registers are stable
+    if (g_pucLightCapture)
+    {
+      for (ucIdx = 0; ucIdx < ADC12_NUM_MEM; ucIdx += 2)
+      {
+        unFirst = *punMem++;
+        unSecond = *punMem++;
+        *g_pucLightCapture++ = (uint8)(unFirst >> 4);
+        *g_pucLightCapture++ = (uint8)((unFirst << 4) | (unSecond >> 8));
+        *g_pucLightCapture++ = (uint8)unSecond;
+      }
+      punMem = &ADC12MEM0;
+    }
+
+    if (g_pulLightBlockAcc)
+    {
+      unBlockSum = 0;				//16 x 4095 fits in 16 bits
+      for (ucIdx = 0; ucIdx < ADC12_NUM_MEM; ucIdx++)
+        unBlockSum += *punMem++;
+      *g_pulLightBlockAcc += unBlockSum;
+    }
+
+    g_uiCounter += ADC12_NUM_MEM;
+    if (g_uiCounter >= g_unLightTarget)
+    {
+      ADC12CTL1 &= ~CONSEQ_3;		//STOP IMMEDIATELY
+      ADC12CTL0 &= ~ENC;
+      __bic_SR_register_on_exit(LPM0_bits);	//exit in active mode
+    }
+    return;
+  }
+
+  //a sequence has ended, every register goes to its accumulator
+  ppulAcc = g_pulaLightSeqAcc;
+  for (ucIdx = g_ucLightSeqLen; ucIdx > 0; ucIdx--)
+    **ppulAcc++ += *punMem++;
+
+  //a timer triggered sequence repeats until the last one
+  if (++g_uiCounter >= g_unLightTarget)
+  {
+    ADC12CTL1 &= ~CONSEQ_3;			//STOP IMMEDIATELY
+    ADC12CTL0 &= ~ENC;
+  }
+
+  __bic_SR_register_on_exit(LPM0_bits);	//exit in active mode
+}
+
+//!
+//! \brief Ends the op-amp settle delay.
+//!
+//! Stops Timer B and returns from the ISR in active mode.
+//!
+#pragma vector = TIMERB0_VECTOR
+__interrupt void TIMERB0_ISR(void)
+{
+  TBCTL &= ~(MC0 | MC1);			//STOP TIMER B
+  TBCCTL0 &= ~CCIE;
+  g_ucLightSettled = 1;
   __bic_SR_register_on_exit(LPM0_bits);	//exit in active mode
-  //P5OUT |= BIT2;					//FOR TESTING
-  g_uiCounter++;
 }
 
 //! \}
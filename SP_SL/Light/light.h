@@ -30,15 +30,236 @@
 #define P_AMP_EN_OUT	P5OUT
 //! @}
 
+//! \def LIGHT_SETTLE_TICKS
+//! \brief Default settle delay in SMCLK/2 ticks (about 17ms)
+#define LIGHT_SETTLE_TICKS	0x84D0
+
+//! \def LIGHT_ADC_BITS
+//! \brief Native resolution of the ADC12
+#define LIGHT_ADC_BITS		12
+
+//! \def LIGHT_MAX_OVERSAMPLE
+//! \brief Largest oversampling exponent, 4^4 samples give 16 effective bits
+#define LIGHT_MAX_OVERSAMPLE	4
+
+//! \def LIGHT_NUM_CHANNELS
+//! \brief The number of light channels on the board
+#define LIGHT_NUM_CHANNELS	4
+
+//! \def LIGHT_ALL_CHANNELS
+//! \brief Channel mask selecting every light channel
+#define LIGHT_ALL_CHANNELS	0x0F
+
+//! \def LIGHT_DEFAULT_AVG
+//! \brief Default number of readings averaged by a channel
+#define LIGHT_DEFAULT_AVG	16
+
+//! @name Light acquisition phases
+//! Phases of the last read, timed in SMCLK/2 ticks. A read whose channels
+//! share one op-amp only has the settle and first conversion phases.
+//! @{
+//! \def LIGHT_PHASE_SETTLE
+//! \brief Settle delay of the first amp group
+#define LIGHT_PHASE_SETTLE		0
+//! \def LIGHT_PHASE_FIRST
+//! \brief Conversion of the first amp group
+#define LIGHT_PHASE_FIRST		1
+//! \def LIGHT_PHASE_WAIT
+//! \brief Settle time of the second amp group left after the first converted
+#define LIGHT_PHASE_WAIT		2
+//! \def LIGHT_PHASE_SECOND
+//! \brief Conversion of the second amp group
+#define LIGHT_PHASE_SECOND		3
+//! \def LIGHT_NUM_PHASES
+//! \brief Number of timed phases
+#define LIGHT_NUM_PHASES		4
+//! @}
+
+//! \struct S_LIGHT_CHANNEL
+//! \brief Describes the hardware of one light channel
+typedef struct
+{
+  unsigned char ucAmpPin;		//!< AMPx_EN bit of the op-amp feeding the channel
+  unsigned char ucInput;		//!< INCH_x input of the channel
+  unsigned int unSettleTicks;	//!< Settle delay in SMCLK/2 ticks
+  unsigned int unAvgCount;		//!< Default number of readings to average
+} S_LIGHT_CHANNEL;
+
+//! @name Light filter modes
+//! Estimator applied to every 16 sample block of a single channel read
+//! @{
+//! \def LIGHT_FILTER_MEAN
+//! \brief Plain arithmetic mean (default)
+#define LIGHT_FILTER_MEAN		0
+//! \def LIGHT_FILTER_MEDIAN
+//! \brief Median of each block
+#define LIGHT_FILTER_MEDIAN		1
+//! \def LIGHT_FILTER_TRIMMED
+//! \brief Mean of each block without its LIGHT_TRIM_SAMPLES lowest and highest samples
+#define LIGHT_FILTER_TRIMMED	2
+//! \def LIGHT_TRIM_SAMPLES
+//! \brief Samples dropped from each end of a block by the trimmed mean
+#define LIGHT_TRIM_SAMPLES		4
+//! @}
+
+
+//! @name Light compensation modes
+//! Corrections that use the VEREF+ (ADC12MEM4), VREF-/VEREF- (ADC12MEM5)
+//! and AVDD/2 (ADC12MEM6) conversions taken with every read
+//! @{
+//! \def LIGHT_COMP_OFF
+//! \brief Readings are not corrected (default)
+#define LIGHT_COMP_OFF		0
+//! \def LIGHT_COMP_REF
+//! \brief Removes the ADC offset and gain error measured on -REF and VEREF+
+#define LIGHT_COMP_REF		1
+//! \def LIGHT_COMP_SUPPLY
+//! \brief Scales readings to the nominal supply, for outputs that track AVDD
+#define LIGHT_COMP_SUPPLY	2
+//! \def LIGHT_REF_SAMPLES
+//! \brief Reference sequences taken after a single channel read
+#define LIGHT_REF_SAMPLES	16
+//! \def LIGHT_AVDD_NOMINAL_Q4
+//! \brief AVDD/2 conversion at nominal supply, 12 bit counts in Q4 (3.3 V / 2 against 2.5 V)
+#define LIGHT_AVDD_NOMINAL_Q4	43243
+//! @}
+
+//! @name Adaptive averaging
+//! Sample count bounds of the adaptive single channel reads, in samples
+//! @{
+//! \def LIGHT_ADAPT_MIN_AVG
+//! \brief Default fewest samples, the pilot block
+#define LIGHT_ADAPT_MIN_AVG		16
+//! \def LIGHT_ADAPT_MAX_AVG
+//! \brief Default most samples
+#define LIGHT_ADAPT_MAX_AVG		256
+//! \def LIGHT_ADAPT_LIMIT
+//! \brief Largest bound accepted
+#define LIGHT_ADAPT_LIMIT		4080
+//! @}
+
+//! @name Dark offset subtraction
+//! The offset of every channel is converted with its op-amp off and cached
+//! with the on-chip temperature sensor (INCH_10) conversion it was taken at.
+//! Two offsets taken LIGHT_DARK_TEMP_STEP or more apart give the channel a
+//! temperature slope, and the offset is then modeled over a wider span.
+//! @{
+//! \def LIGHT_DARK_SAMPLES
+//! \brief Conversions averaged into a dark offset
+#define LIGHT_DARK_SAMPLES		16
+//! \def LIGHT_TEMP_SAMPLES
+//! \brief Temperature sensor conversions averaged into a temperature
+#define LIGHT_TEMP_SAMPLES		4
+//! \def LIGHT_TEMP_READS
+//! \brief Reads that share one temperature before the sensor is converted again
+#define LIGHT_TEMP_READS		8
+//! \def LIGHT_DARK_TEMP_STEP
+//! \brief Temperature span of an offset without a slope, Q4 counts (about 1 C at 3.55 mV/C against 2.5 V)
+#define LIGHT_DARK_TEMP_STEP	93
+//! \def LIGHT_DARK_MODEL_SPAN
+//! \brief Temperature span of an offset with a slope, Q4 counts (about 8 C)
+#define LIGHT_DARK_MODEL_SPAN	744
+//! \def LIGHT_DARK_SLOPE_SHIFT
+//! \brief Fraction bits of the dark slopes, offset counts per temperature count
+#define LIGHT_DARK_SLOPE_SHIFT	12
+//! @}
+
+//! @name Light sequence extras
+//! Channels appended to an ADC12 sequence after the light channels
+//! @{
+//! \def LIGHT_SEQ_REFS
+//! \brief VEREF+, -REF and AVDD/2
+#define LIGHT_SEQ_REFS		0x01
+//! \def LIGHT_SEQ_TEMP
+//! \brief On-chip temperature sensor
+#define LIGHT_SEQ_TEMP		0x02
+//! @}
+
+//! @name Timer triggered sampling
+//! Timer B output 1 starts every conversion (SHS_3) at a fixed rate.
+//! @{
+//! \def LIGHT_TIMER_HZ
+//! \brief Timer B clock, SMCLK/2
+#define LIGHT_TIMER_HZ			2000000UL
+//! \def LIGHT_MIN_TRIGGER_TICKS
+//! \brief Shortest trigger period, one 384 cycle sample plus conversion at ADC12CLK = SMCLK/8
+#define LIGHT_MIN_TRIGGER_TICKS	1600
+//! @}
+
+//! @name Burst capture
+//! Raw samples of one channel are packed two in three bytes, big endian:
+//! a11..a4, a3..a0 b11..b8, b7..b0.
+//! @{
+//! \def LIGHT_CAPTURE_LEN
+//! \brief Largest number of samples in a capture (multiple of 16)
+#define LIGHT_CAPTURE_LEN		256
+//! \def LIGHT_CAPTURE_BYTES
+//! \brief Size of the packed capture buffer
+#define LIGHT_CAPTURE_BYTES		(LIGHT_CAPTURE_LEN / 2 * 3)
+//! @}
+
+//! @name Flicker analysis
+//! A full capture at LIGHT_FLICKER_HZ is reduced to a report of
+//! LIGHT_FLICKER_REPORT_LEN bytes: percent modulation, flicker index in
+//! percent, the strongest of the 100/120/200/240 Hz components (0-3, or
+//! LIGHT_FLICKER_NONE in the dark) and its amplitude in percent of the mean.
+//! @{
+//! \def LIGHT_FLICKER_HZ
+//! \brief Sample rate of the flicker capture
+#define LIGHT_FLICKER_HZ			1000
+//! \def LIGHT_FLICKER_BINS
+//! \brief Number of Goertzel frequencies
+#define LIGHT_FLICKER_BINS			4
+//! \def LIGHT_FLICKER_NONE
+//! \brief Component index reported when there is no light
+#define LIGHT_FLICKER_NONE			0xFF
+//! \def LIGHT_FLICKER_REPORT_LEN
+//! \brief Length of the flicker report
+#define LIGHT_FLICKER_REPORT_LEN	4
+//! @}
+
+//! @name Light calibration
+//! The calibration table maps a reading to engineering units with
+//! y = offset + gain * x + quad * x^2, where x is the reading scaled to a
+//! Q15 fraction of full scale. Gain and quad are the output at full scale.
+//! The table is stored big endian: marker, channel enable mask, then
+//! offset, gain and quad (signed 16 bit) of channels 1-4.
+//! @{
+//! \def LIGHT_CAL_MARKER
+//! \brief First byte of a valid calibration table
+#define LIGHT_CAL_MARKER	0xC1
+//! \def LIGHT_CAL_CHANNEL_LEN
+//! \brief Bytes of calibration per channel
+#define LIGHT_CAL_CHANNEL_LEN	6
+//! \def LIGHT_CAL_LEN
+//! \brief Length of the calibration table
+#define LIGHT_CAL_LEN		(2 + LIGHT_CAL_CHANNEL_LEN * LIGHT_NUM_CHANNELS)
+//! @}
+
 
 //! Function prototypes
 //! @name Light measurement utility functions
 //! @{
 void vLight_Init(void);
 void vLight_Shutdown(void);
-unsigned int unLIGHT_ReadChannel_1(unsigned int * punAvgCount, unsigned int * punDummy);
-unsigned int unLIGHT_ReadChannel_2(unsigned int * punAvgCount, unsigned int * punDummy);
-unsigned int unLIGHT_ReadChannel_3(unsigned int * punAvgCount, unsigned int * punDummy);
-unsigned int unLIGHT_ReadChannel_4(unsigned int * punAvgCount, unsigned int * punDummy);
+void vLIGHT_Hold(unsigned char ucHold);
+unsigned char ucLIGHT_IsPowered(void);
+void vLIGHT_SetSettleTicks(unsigned char ucChannel, unsigned int unTicks);
+void vLIGHT_SetOversampling(unsigned char ucExponent);
+void vLIGHT_SetFilter(unsigned char ucMode);
+void vLIGHT_SetCompensation(unsigned char ucMode);
+void vLIGHT_SetDarkCorrection(unsigned char ucEnable);
+void vLIGHT_SetAdaptive(unsigned char ucNoiseQ4, unsigned int unMin, unsigned int unMax);
+unsigned int unLIGHT_GetAdaptiveCount(void);
+void vLIGHT_SetSampleRate(unsigned int unRateHz);
+unsigned char ucLIGHT_LoadCalibration(volatile unsigned char * pucTable, unsigned char ucLen);
+unsigned int unLIGHT_Calibrate(unsigned char ucChannel, unsigned int unRaw, unsigned char ucResolution);
+unsigned char ucLIGHT_GetResolution(void);
+unsigned int unLIGHT_GetPhaseTicks(unsigned char ucPhase);
+void vLIGHT_ReadChannels(unsigned char ucMask, unsigned int * punAvgCount, unsigned int * punaResults);
+unsigned int unLIGHT_ReadChannel(unsigned char ucChannel, unsigned int * punAvgCount);
+unsigned int unLIGHT_Capture(unsigned char ucChannel, unsigned int unSamples);
+unsigned char * pucLIGHT_GetCapture(void);
+unsigned char ucLIGHT_AnalyzeFlicker(unsigned char ucChannel, unsigned char * pucReport);
 //! @}
 #endif /* LIGHT_H_ */
@@ -93,6 +93,7 @@
 // Functions visible to the core.  Adding these functions makes the core scalable to any application
 // since the core does not need to know anything about the specifics of the application layer.
 uint8 ucMain_FetchData(volatile uint8 * pBuff);
+uint8 ucMain_DataPending(void);
 void vMain_FetchLabel(uint8 ucTransNum, volatile uint8 * pucArr);
 uint16 uiMainDispatch(uint8 ucCmdTransNum, uint8 ucCmdParamLen, uint8 *ucParam);
 uint8 ucMAIN_ReturnSensorType(uint8 ucSensorCount);
@@ -101,6 +102,10 @@ uint8 ucMain_getNumTransducers(void);
 uint8 ucMain_getSampleDuration(uint8 ucTransNum);
 uint8 ucMain_getTransducerType(uint8 ucTransNum);
 void vMain_EventTrigger(void);
+void vMain_SessionBegin(void);
+void vMain_SessionEnd(void);
 uint8 ucMain_ShutdownAllowed(void);
+uint8 ucMain_GetCalTable(volatile uint8 * pucBuff);
+uint8 ucMain_SetCalTable(volatile uint8 * pucBuff, uint8 ucLen);
 #endif /* CHANGEABLE_CORE_HEADER_H_ */
 
@@ -53,6 +53,49 @@ uint16 g_unCOMM_BaudRateControl;
 uint16 g_unCOMM_BaudRateDelayControl;
 //! @}
 
+//! \var const uint8 g_ucaCOMM_ParityLUT[16]
+//! \brief Even parity bit of every nibble
+const uint8 g_ucaCOMM_ParityLUT[16] = { 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0 };
+
+//******************  Rate Test Variables  **********************************//
+//! @name Rate Test Variables
+//! These variables collect the SCL periods of the messages while the rate
+//! test is running.
+//! @{
+//! \var uint8 g_ucCOMM_RateTest
+//! \brief Non zero while the rate test times the messages
+uint8 g_ucCOMM_RateTest;
+
+//! \var uint16 g_uiCOMM_RateBest
+//! \brief Shortest SCL period of a message without parity or ack errors, in ns
+uint16 g_uiCOMM_RateBest = 0xFFFF;
+
+//! \var uint16 g_uiCOMM_RateWorst
+//! \brief Longest SCL period of a message with parity or ack errors, in ns
+uint16 g_uiCOMM_RateWorst;
+
+//! \var uint8 g_ucCOMM_RateGood
+//! \brief The number of messages without errors
+uint8 g_ucCOMM_RateGood;
+
+//! \var uint8 g_ucCOMM_RateBad
+//! \brief The number of messages with parity, ack, CRC or frame errors
+uint8 g_ucCOMM_RateBad;
+//! @}
+
+//******************  Timeout Variables  ************************************//
+//! @name Timeout Variables
+//! These variables let TIMERB1_ISR() tell a slow message from a stalled one.
+//! @{
+//! \var uint8 g_ucCOMM_TimerWrapped
+//! \brief Non zero once Timer B overflowed during the message
+volatile uint8 g_ucCOMM_TimerWrapped;
+
+//! \var uint8 g_ucCOMM_Progress
+//! \brief Bytes received, sent and nacked at the last overflow
+uint8 g_ucCOMM_Progress;
+//! @}
+
 //******************  RX Variables  *****************************************//
 //! @name Receive Variables
 //! These variables are used in the receiving of data on the \ref comm Module.
@@ -72,6 +115,67 @@ uint8 g_ucRXBitsLeft;
 //! \var uint8 g_ucRXParityBit
 //! \brief Even Parity for bit banging uart
 uint8 ucRXParityBit;
+
+//! \var uint8 g_ucRXState
+//! \brief State of the SCL interrupt receive, one of the \ref COMM_RX_DATA states
+uint8 g_ucRXState;
+
+//! \var uint8 g_ucRXByte
+//! \brief The byte being shifted in by the SCL interrupt
+uint8 g_ucRXByte;
+
+//! \var uint8 g_ucRXMessageSize
+//! \brief Bytes of the message being received, header and CRC included
+uint8 g_ucRXMessageSize;
+
+//! \var uint8 g_ucaRXCRC[2]
+//! \brief Streaming CRC of the bytes received so far
+uint8 g_ucaRXCRC[2];
+//! @}
+
+//******************  TX Variables  *****************************************//
+//! @name Transmit Variables
+//! These variables are used by the SCL interrupt to send a message.
+//! @{
+//! \var volatile uint8 * g_pucTXBuffer
+//! \brief The byte of the message being sent
+volatile uint8 * g_pucTXBuffer;
+
+//! \var uint8 g_ucTXLength
+//! \brief The length of the message being sent, CRC included
+uint8 g_ucTXLength;
+
+//! \var uint8 g_ucTXBytesLeft
+//! \brief The number of bytes left to send, the current one included
+uint8 g_ucTXBytesLeft;
+
+//! \var uint16 g_uiTXShift
+//! \brief The data and parity bits of the current byte not yet on the line
+uint16 g_uiTXShift;
+
+//! \var uint8 g_ucTXBitsLeft
+//! \brief The number of data and parity bits left, the one on the line included
+uint8 g_ucTXBitsLeft;
+
+//! \var uint8 g_ucTXState
+//! \brief State of the SCL interrupt transmit, one of the \ref COMM_TX_BITS states
+uint8 g_ucTXState;
+
+//! \var uint8 g_ucTXNack
+//! \brief Non zero when the CP nacked the current byte
+uint8 g_ucTXNack;
+
+//! \var uint8 g_ucTXErrors
+//! \brief The number of nacked bytes of the message
+uint8 g_ucTXErrors;
+
+//! \var uint8 g_ucaTXCRC[2]
+//! \brief Streaming CRC of the bytes acked so far
+uint8 g_ucaTXCRC[2];
+
+//! \var uint8 g_ucaTXCRCNext[2]
+//! \brief Streaming CRC including the byte on the line, kept once it is acked
+uint8 g_ucaTXCRCNext[2];
 //! @}
 
 
@@ -120,6 +224,77 @@ void vCOMM_Init()
 	g_ucCOMM_Flags = COMM_RUNNING;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Starts the message timer
+//!
+//! Timer B runs from the start condition to the end of the message. It
+//! times the message for the rate test and, overflowing every 131 ms, lets
+//! TIMERB1_ISR() drop a message that stopped clocking.
+//!   \param None
+//!   \return None
+///////////////////////////////////////////////////////////////////////////////
+static void vCOMM_TimerStart(void)
+{
+	g_ucCOMM_TimerWrapped = 0;
+	g_ucCOMM_Progress = (uint8)(g_ucRXBufferIndex - g_ucTXBytesLeft + g_ucTXErrors);
+
+	TBCCTL0 = 0;								// No CCR0 interrupt
+	TBCTL = TBSSEL_2 | ID_3 | TBCLR | TBIE;	// SMCLK/8, 16-bit, cleared, overflow interrupt
+	TBCTL |= MC_2;								// Continuous mode
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Stops the message timer and adds the message to the rate test
+//!
+//! Each byte takes 10 clocks: 8 data bits, parity and ack. Every message
+//! is counted good or bad, but only one that clocked bytes within a single
+//! timer period gives an SCL period.
+//!   \param ucClockBytes Bytes clocked, resent ones included; ucError Non zero
+//!   if the message had a parity, ack, CRC or frame error
+//!   \return None
+///////////////////////////////////////////////////////////////////////////////
+static void vCOMM_TimerStop(uint8 ucClockBytes, uint8 ucError)
+{
+	uint32 ulPeriod;
+
+	TBCTL &= ~(MC0 | MC1 | TBIE);		// Stop timer B
+
+	if (TBCTL & TBIFG) {
+		TBCTL &= ~TBIFG;
+		ucClockBytes = 0;
+	}
+	if (g_ucCOMM_TimerWrapped)
+		ucClockBytes = 0;
+
+	if (!g_ucCOMM_RateTest)
+		return;
+
+	if (ucError) {
+		if (g_ucCOMM_RateBad != 0xFF)
+			g_ucCOMM_RateBad++;
+	}
+	else {
+		if (g_ucCOMM_RateGood != 0xFF)
+			g_ucCOMM_RateGood++;
+	}
+
+	if (ucClockBytes == 0)
+		return;
+
+	ulPeriod = ulFIXMATH_MulU16(TBR, COMM_RATE_TICK_NS) / ((uint16)ucClockBytes * 10);
+	if (ulPeriod > 0xFFFF)
+		ulPeriod = 0xFFFF;
+
+	if (ucError) {
+		if ((uint16)ulPeriod > g_uiCOMM_RateWorst)
+			g_uiCOMM_RateWorst = (uint16)ulPeriod;
+	}
+	else {
+		if ((uint16)ulPeriod < g_uiCOMM_RateBest)
+			g_uiCOMM_RateBest = (uint16)ulPeriod;
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //! \brief Waits for the start signal from the CP board
 //!
@@ -127,41 +302,70 @@ void vCOMM_Init()
 //! but the clock needs to be low before entering the send and receive bytes
 //! functions.
 //!
+//! Start detection stays armed while the core handles an event, so a start
+//! condition sent during a background sweep is latched by PORT1_ISR(). The
+//! SP cannot stretch SCL, so if the CP has clocked a data bit by the time
+//! the start is picked up, the message is already partly gone: the start
+//! is dropped, detection stays armed and 0 is returned. A message sent
+//! during a sweep is lost this way and has to be retried by the CP. A
+//! start picked up before its first data bit is received normally.
+//! Detection is disarmed while a message is on the bus, where the SDA data
+//! edges would cost edge budget.
+//!
 //!          __________________________
 //! SCL _____|                         |____
 //!           _________________
 //! SDA _____|                 |_____________
 //!
 //!   \param None
-//!   \return 1 if start condition received else 0
+//!   \return 1 if start condition received else 0, also for a stale one
 ///////////////////////////////////////////////////////////////////////////////
 uint8 ucCOMM_WaitForStartCondition(void)
 {
-	// Clear the flag
-	g_ucCOMM_Flags &= ~COMM_START_CONDITION;
-
-	// Enable interrupts on the SDA line
-	P_SDA_IFG &= ~SDA_PIN;
-	P_SDA_IE |= SDA_PIN;
-
-	// Wait in deep sleep
-	LPM3;
+	// Arm the SDA line unless it is still armed from an event wake-up,
+	// clearing a latched start condition here would lose it
+	if (!(P_SDA_IE & SDA_PIN)) {
+		g_ucCOMM_Flags &= ~COMM_START_CONDITION;
+		P_SDA_IFG &= ~SDA_PIN;
+		P_SDA_IE |= SDA_PIN;
+	}
 
-	// Disable interrupts on the SDA line
-	P_SDA_IE &= ~SDA_PIN;
+	// Wait in deep sleep unless a start condition is already latched
+	__disable_interrupt();
+	if (!(g_ucCOMM_Flags & COMM_START_CONDITION))
+		__bis_SR_register(GIE + LPM3_bits);
+	__enable_interrupt();
 
 	// Prepare for communication if the start condition flag is set
 	if (g_ucCOMM_Flags & COMM_START_CONDITION) {
 
-		// Clear the flag
-		g_ucCOMM_Flags &= ~COMM_START_CONDITION;
+		// A rising clock since the start is a data bit already missed,
+		// drop the stale start and leave the SDA line armed
+		if (P_SCL_IFG & SCL_PIN) {
+			g_ucCOMM_Flags &= ~COMM_START_CONDITION;
+			return 0;
+		}
 
-		// Enable interrupts on the falling edge of the clock line
-		P_SCL_IFG &= ~SCL_PIN;
+		// Disable interrupts on the SDA line during the message
+		P_SDA_IE &= ~SDA_PIN;
+
+		// Clear the flags
+		g_ucCOMM_Flags &= ~(COMM_START_CONDITION | COMM_FRAME_ERR);
+
+		// Switch to the falling edge of the clock line that ends the start
+		// condition, writing PxIES can set the flag so clear it after
 		P_SCL_IES |= SCL_PIN;
+		P_SCL_IFG &= ~SCL_PIN;
 
-		// Wait for the clock to go low then clear the flag
-		while (!(P_SCL_IFG & SCL_PIN));
+		// Wait for the clock to go low unless it already is, then clear
+		// the flag. A glitch that never clocks is dropped by the timeout
+		// and detection re-armed
+		vCOMM_TimerStart();
+		if (P_SCL_IN & SCL_PIN) {
+			COMM_SCL_WAIT();
+			if (g_ucCOMM_Flags & COMM_FRAME_ERR)
+				return 0;
+		}
 		P_SCL_IFG &= ~SCL_PIN;
 
 		return 1;
@@ -170,6 +374,18 @@ uint8 ucCOMM_WaitForStartCondition(void)
 	return 0;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Returns the even parity bit of a byte
+//!
+//! Two lookups in a 16 byte table replace the 8 step loop.
+//!   \param ucByte The byte
+//!   \return 1 if ucByte has an odd number of ones else 0
+///////////////////////////////////////////////////////////////////////////////
+static uint8 ucCOMM_Parity(uint8 ucByte)
+{
+	return g_ucaCOMM_ParityLUT[ucByte & 0x0F] ^ g_ucaCOMM_ParityLUT[ucByte >> 4];
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //! \brief Sends a byte via the software I2C
 //!
@@ -178,18 +394,20 @@ uint8 ucCOMM_WaitForStartCondition(void)
 //! jump tables in assembly which take several cycles before executing a particular case.
 //! They have been replace with if statements which only require 2 or 3 instructions.
 //!
+//! The bit loop is unrolled and tests every bit of ucTXChar in place, so
+//! nothing is shifted or counted between edges. The parity comes from a
+//! lookup before the first edge. The next bit is driven before the flag is
+//! cleared, so the worst case from a falling SCL edge to the bit on SDA is
+//! \ref COMM_POLLED_EDGE_CYCLES (see comm.h). The byte is added to the
+//! streaming CRC g_ucaTXCRCNext while the parity bit is on the line.
+//!
 //!   \param ucTXChar The 8-bit value to send
 //!   \return None
 ///////////////////////////////////////////////////////////////////////////////
 uint8 ucCOMM_SendByte(uint8 ucTXChar)
 {
 	uint8 ucParityBit;
-	uint8 ucBitIdx;
-	uint8 ucTXBitsLeft;
 	uint8 ucAck;
-	uint16 uiTXChar;
-	uint8 ucSDABit;
-	uint8 ucSCLBit;
 
 	// If we are already busy, return
 	if (g_ucCOMM_Flags & COMM_TX_BUSY)
@@ -198,71 +416,60 @@ uint8 ucCOMM_SendByte(uint8 ucTXChar)
 	// Indicate in the status register that we are now busy
 	g_ucCOMM_Flags |= COMM_TX_BUSY;
 
-	// Local declarations of this bits place the values in registers - accessing them is faster.
-	ucSDABit = (uint8)SDA_PIN;
-	ucSCLBit = (uint8)SCL_PIN;
-
 	// Calculate the parity bit prior to transmission
-	ucParityBit = 0;
-	for (ucBitIdx = 0; ucBitIdx < 8; ucBitIdx++) {
-		ucParityBit ^= ((ucTXChar >> ucBitIdx) & 0x01);
-	}
-
-	// Combine the data and parity into one variable (more time saving)
-	uiTXChar = (uint16)(ucTXChar | (ucParityBit << 8));
-
-	// Reset the bit count
-	ucTXBitsLeft = 9;
+	ucParityBit = ucCOMM_Parity(ucTXChar);
 
 	// Enable interrupts on the falling edge of the clock line
-	P_SCL_IFG &= ~ucSCLBit;
-	P_SCL_IES |= ucSCLBit;
-
-	// Set the direction of the data line to output
-	P_SDA_DIR |= ucSDABit;
-
-	// Transmission loop which controls the UART timing for byte transmission
-	do{
-
-		// For data bits, mask to get correct value and the shift for next time
-		if (uiTXChar & 0x01)
-			P_SDA_OUT |= ucSDABit;
-		else
-			P_SDA_OUT &= ~ucSDABit;
-
-		// Decrement the total bit count and shift byte
-		ucTXBitsLeft--;
-		uiTXChar >>= 1;
+	P_SCL_IFG &= ~SCL_PIN;
+	P_SCL_IES |= SCL_PIN;
 
-		// Wait for the next falling clock
-		while (!(P_SCL_IFG & ucSCLBit));
-		P_SCL_IFG &= ~ucSCLBit;
+	// Put the first bit on the line and set the data line to output
+	COMM_SDA_DRIVE(ucTXChar & BIT0);
+	P_SDA_DIR |= SDA_PIN;
 
-	}while (ucTXBitsLeft != 0);
+	// The rest of the data bits and the parity bit, one per falling clock
+	COMM_TX_NEXT(ucTXChar & BIT1);
+	COMM_TX_NEXT(ucTXChar & BIT2);
+	COMM_TX_NEXT(ucTXChar & BIT3);
+	COMM_TX_NEXT(ucTXChar & BIT4);
+	COMM_TX_NEXT(ucTXChar & BIT5);
+	COMM_TX_NEXT(ucTXChar & BIT6);
+	COMM_TX_NEXT(ucTXChar & BIT7);
+	COMM_TX_NEXT(ucParityBit);
+
+	// The parity bit lasts a whole clock, room to run the byte through the
+	// CRC. A nacked byte is sent again, so the CRC only moves on once acked
+	g_ucaTXCRCNext[CRC16_HI] = g_ucaTXCRC[CRC16_HI];
+	g_ucaTXCRCNext[CRC16_LO] = g_ucaTXCRC[CRC16_LO];
+	vCRC16_updateByte(ucTXChar, g_ucaTXCRCNext);
+
+	// Wait for the falling clock that ends the parity bit
+	COMM_SCL_WAIT();
+	P_SCL_IFG &= ~SCL_PIN;
 
 	// Next bit is ack so switch the direction of the SDA pin
-	P_SDA_DIR &= ~ucSDABit;
+	P_SDA_DIR &= ~SDA_PIN;
 
 	// Switch clock edge interrupt
-	P_SCL_IES &= ~ucSCLBit;
+	P_SCL_IES &= ~SCL_PIN;
 
 	// Wait for the next rising clock
-	while (!(P_SCL_IFG & ucSCLBit));
-	P_SCL_IFG &= ~ucSCLBit;
+	COMM_SCL_WAIT();
+	P_SCL_IFG &= ~SCL_PIN;
 
 	// Last bit is ack bit, return to idle state
-	ucAck = (P_SDA_IN & ucSDABit);
+	ucAck = (P_SDA_IN & SDA_PIN);
 
 	// Switch clock edge interrupt
-	P_SCL_IES |= ucSCLBit;
+	P_SCL_IES |= SCL_PIN;
 
 	// Wait for the next clock
-	while (!(P_SCL_IFG & ucSCLBit));
-	P_SCL_IFG &= ~ucSCLBit;
+	COMM_SCL_WAIT();
+	P_SCL_IFG &= ~SCL_PIN;
 
 	g_ucCOMM_Flags &= ~COMM_TX_BUSY;
 
-	if (ucAck == 1)
+	if (ucAck)
 		return COMM_ACK_ERR;
 	else
 		return COMM_OK;
@@ -276,13 +483,18 @@ uint8 ucCOMM_SendByte(uint8 ucTXChar)
 //! jump tables in assembly which take several cycles before executing a particular case.
 //! They have been replace with if statements which only require 2 or 3 instructions.
 //!
+//! The bit loop is unrolled and sets every bit of the byte in place, the
+//! parity is looked up once the parity bit is in. SDA is sampled before
+//! the flag is cleared, so the worst case per rising SCL edge is
+//! \ref COMM_POLLED_EDGE_CYCLES (see comm.h). The byte is added to the
+//! streaming CRC g_ucaRXCRC while the ack bit is on the line.
+//!
 //!   \param none
 //!   \return error code
 //!   \sa vCOMM_Init()
 ///////////////////////////////////////////////////////////////////////////////
 uint8 ucCOMM_ReceiveByte(void)
 {
-	uint8 ucRXBitsLeft;
 	uint8 ucParityBit; // The calculated parity bit
 	uint8 ucRxParityBit; // The received parity bit
 	uint8 ucRXByte;
@@ -294,9 +506,8 @@ uint8 ucCOMM_ReceiveByte(void)
 	// Indicate in the status register that we are now busy
 	g_ucCOMM_Flags |= COMM_RX_BUSY;
 
-	// Init the parity bit and the bit count
-	ucParityBit = 0;
-	ucRXBitsLeft = 8;
+	ucRXByte = 0;
+	ucRxParityBit = 0;
 
 	// Enable interrupts on rising edges of the SCL line
 	P_SCL_IFG &= ~SCL_PIN;
@@ -305,56 +516,38 @@ uint8 ucCOMM_ReceiveByte(void)
 	// Set the direction of the data line to input
 	P_SDA_DIR &= ~SDA_PIN;
 
-	do {
-		// Wait for the next clock
-		while (!(P_SCL_IFG & SCL_PIN));
-		P_SCL_IFG &= ~SCL_PIN;
-
-		// Shift over for the next bit
-		ucRXByte >>= 1;
-
-		// Sample the data line
-		if (P_SDA_IN & SDA_PIN) {
-			ucRXByte |= 0x80;
-			ucParityBit++;
-		}
-		else {
-			ucRXByte &= ~0x80;
-		}
-
-	}while (--ucRXBitsLeft != 0);
-
-	// Wait for the next rising clock
-	while (!(P_SCL_IFG & SCL_PIN));
-	P_SCL_IFG &= ~SCL_PIN;
-
-	// Sample the parity bit
-	if (P_SDA_IN & SDA_PIN)
-		ucRxParityBit = 1;
-	else
-		ucRxParityBit = 0;
+	// Data bits LSB first, then the parity bit, one per rising clock
+	COMM_RX_NEXT(ucRXByte, BIT0);
+	COMM_RX_NEXT(ucRXByte, BIT1);
+	COMM_RX_NEXT(ucRXByte, BIT2);
+	COMM_RX_NEXT(ucRXByte, BIT3);
+	COMM_RX_NEXT(ucRXByte, BIT4);
+	COMM_RX_NEXT(ucRXByte, BIT5);
+	COMM_RX_NEXT(ucRXByte, BIT6);
+	COMM_RX_NEXT(ucRXByte, BIT7);
+	COMM_RX_NEXT(ucRxParityBit, 0x01);
 
 	// Set the interrupt edge select for falling
 	P_SCL_IES |= SCL_PIN;
 
+	// Compute the parity while the parity bit is clocked
+	ucParityBit = ucCOMM_Parity(ucRXByte);
+
 	// Wait for the next falling clock
-	while (!(P_SCL_IFG & SCL_PIN));
+	COMM_SCL_WAIT();
 	P_SCL_IFG &= ~SCL_PIN;
 
-	ucParityBit = ucParityBit % 2;
 	// If the calculated and received parity bits match then send ack, else nack
-	if (ucParityBit == ucRxParityBit) {
-		P_SDA_OUT &= ~SDA_PIN;
-	}
-	else {
-		P_SDA_OUT |= SDA_PIN;
-	}
+	COMM_SDA_DRIVE(ucParityBit != ucRxParityBit);
 
 	// Next bit is ack so switch the direction of the SDA pin
 	P_SDA_DIR |= SDA_PIN;
 
+	// The ack lasts a whole clock, room to run the byte through the CRC
+	vCRC16_updateByte(ucRXByte, g_ucaRXCRC);
+
 	// Wait for the next falling clock clock
-	while (!(P_SCL_IFG & SCL_PIN));
+	COMM_SCL_WAIT();
 	P_SCL_IFG &= ~SCL_PIN;
 
 	// Switch direction back to input
@@ -373,6 +566,49 @@ uint8 ucCOMM_ReceiveByte(void)
 
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Starts or stops the SCL rate test
+//!
+//! While the test runs Timer B times every message from its first clock to
+//! the end of its last ack bit, which gives the average SCL period the CP
+//! used. The fastest period received and sent without parity or ack errors
+//! is the rate ceiling of the SP. Messages with CRC or frame errors, a
+//! stalled clock included, are counted as failed. Timer B is shared with
+//! the light front end, which never runs during a message. The results are
+//! cleared.
+//!   \param ucEnable Non zero to time the messages
+//!   \return None
+///////////////////////////////////////////////////////////////////////////////
+void vCOMM_RateTest(uint8 ucEnable)
+{
+	g_ucCOMM_RateTest = ucEnable;
+	g_uiCOMM_RateBest = 0xFFFF;
+	g_uiCOMM_RateWorst = 0;
+	g_ucCOMM_RateGood = 0;
+	g_ucCOMM_RateBad = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Writes the results of the SCL rate test
+//!
+//! The report is COMM_RATE_REPORT_LEN bytes, periods big endian in ns:
+//! fastest period without errors (0xFFFF if none), slowest period with
+//! errors (0 if none), then the number of good and of failed messages.
+//!   \param pucReport Where the report is written
+//!   \return The length of the report
+///////////////////////////////////////////////////////////////////////////////
+uint8 ucCOMM_RateReport(uint8 * pucReport)
+{
+	*pucReport++ = (uint8)(g_uiCOMM_RateBest >> 8);
+	*pucReport++ = (uint8) g_uiCOMM_RateBest;
+	*pucReport++ = (uint8)(g_uiCOMM_RateWorst >> 8);
+	*pucReport++ = (uint8) g_uiCOMM_RateWorst;
+	*pucReport++ = g_ucCOMM_RateGood;
+	*pucReport = g_ucCOMM_RateBad;
+
+	return COMM_RATE_REPORT_LEN;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //! \brief Shuts off the software modules
 //!
@@ -402,16 +638,25 @@ void vCOMM_Shutdown(void)
 ///////////////////////////////////////////////////////////////////////////////
 uint8 ucCOMM_WaitForMessage(void)
 {
+#ifdef COMM_RX_POLLED
 
 uint8 ucRXMessageSize;
 
+	g_ucRXBufferIndex = 0x00;
+	g_ucCOMM_Flags &= ~(COMM_FRAME_ERR | COMM_PARITY_ERR);
+	vCRC16_init(g_ucaRXCRC);
+	vCOMM_TimerStart();
+
  // Set the size of the received message to the minimum
 	ucRXMessageSize = SP_HEADERSIZE;
 
 	// Wait to receive the message
 	do {
 
-		if (ucCOMM_ReceiveByte()) {
+		// A failed byte or a stalled clock drops the message
+		if (ucCOMM_ReceiveByte() || (g_ucCOMM_Flags & COMM_FRAME_ERR)) {
+			vCOMM_TimerStop(g_ucRXBufferIndex, 1);
+			g_ucRXBufferIndex = 0x00;
 			return COMM_ERROR;
 		}
 
@@ -421,13 +666,57 @@ uint8 ucRXMessageSize;
 			ucRXMessageSize = g_ucaRXBuffer[MSG_LEN_IDX] + CRC_SZ;
 
 			// Range check the g_ucRXMessageSize variable
-			if (ucRXMessageSize > MAXMSGLEN || ucRXMessageSize < SP_HEADERSIZE)
+			if (ucRXMessageSize > MAXMSGLEN || ucRXMessageSize < SP_HEADERSIZE) {
+				vCOMM_TimerStop(g_ucRXBufferIndex, 1);
+				g_ucRXBufferIndex = 0x00;
 				return COMM_ERROR;
+			}
 		}
 
 	}
 	while (g_ucRXBufferIndex != ucRXMessageSize);
 
+#else
+
+	// Arm the state machine for the first data bit of the header, a message
+	// always starts at the beginning of the buffer
+	g_ucRXBufferIndex = 0x00;
+	g_ucRXMessageSize = SP_HEADERSIZE;
+	vCRC16_init(g_ucaRXCRC);
+	g_ucRXState = COMM_RX_DATA;
+	g_ucRXBitsLeft = 8;
+	g_ucCOMM_Flags &= ~(COMM_RX_DONE | COMM_FRAME_ERR | COMM_PARITY_ERR);
+	g_ucCOMM_Flags |= COMM_RX_BUSY;
+	vCOMM_TimerStart();
+
+	// Set the direction of the data line to input
+	P_SDA_DIR &= ~SDA_PIN;
+
+	// Interrupt on rising edges of the SCL line
+	P_SCL_IES &= ~SCL_PIN;
+	P_SCL_IFG &= ~SCL_PIN;
+	P_SCL_IE |= SCL_PIN;
+
+	// Sleep between the clock edges until the ISR has the whole message
+	__disable_interrupt();
+	while (!(g_ucCOMM_Flags & COMM_RX_DONE)) {
+		__bis_SR_register(GIE + LPM0_bits);
+		__disable_interrupt();
+	}
+	__enable_interrupt();
+
+	// A bad length or a stalled clock drops the message
+	if (g_ucCOMM_Flags & COMM_FRAME_ERR) {
+		vCOMM_TimerStop(g_ucRXBufferIndex, 1);
+		g_ucRXBufferIndex = 0x00;
+		return COMM_ERROR;
+	}
+
+#endif
+
+	vCOMM_TimerStop(g_ucRXBufferIndex,
+			(g_ucCOMM_Flags & COMM_PARITY_ERR) || !ucCRC16_final(g_ucaRXCRC));
+
 	// No message received
 	if (g_ucRXBufferIndex == 0) {
 		return COMM_ERROR;
@@ -448,34 +737,153 @@ uint8 ucRXMessageSize;
 ///////////////////////////////////////////////////////////////////////////////.
 void vCOMM_SendMessage(volatile uint8 * pBuff, uint8 ucLength)
 {
+#ifdef COMM_TX_POLLED
 	uint8 ucLoopCount;
-	uint8 ucErrorCount;
 
-	// Clear error count
-	ucErrorCount = 0;
+	// Clear error count, the timeout watches the counts
+	g_ucTXBytesLeft = ucLength + CRC_SZ;
+	g_ucTXErrors = 0;
+	g_ucCOMM_Flags &= ~COMM_FRAME_ERR;
 
-	// add the CRC bytes to the length
-	ucLength += CRC_SZ;
+	// The CRC is computed as the bytes go out
+	vCRC16_init(g_ucaTXCRC);
 
-	// Compute the CRC of the message
-	ucCRC16_compute_msg_CRC(CRC_FOR_MSG_TO_SEND, pBuff, ucLength);
+	vCOMM_TimerStart();
 
-	for (ucLoopCount = 0x00; ucLoopCount < ucLength; ucLoopCount++) {
+	// Send the message followed by its CRC bytes
+	for (ucLoopCount = 0x00; ucLoopCount < ucLength + CRC_SZ; ucLoopCount++) {
 
 		// Attempt to send a byte
-		if (ucCOMM_SendByte(*pBuff++) != COMM_OK) {
+		if (ucCOMM_SendByte(*pBuff) == COMM_OK) {
+			pBuff++;
+			g_ucTXBytesLeft--;
+
+			// Keep the CRC of the acked bytes, after the last one it is the
+			// CRC of the message and goes out next
+			g_ucaTXCRC[CRC16_HI] = g_ucaTXCRCNext[CRC16_HI];
+			g_ucaTXCRC[CRC16_LO] = g_ucaTXCRCNext[CRC16_LO];
+			if (ucLoopCount == ucLength - 1) {
+				pBuff[0] = g_ucaTXCRC[CRC16_HI];
+				pBuff[1] = g_ucaTXCRC[CRC16_LO];
+			}
+		}
+		else {
 
 			// If there is an error then increment the error count
-			ucErrorCount++;
+			g_ucTXErrors++;
 
 			// Decrement the loop count to attempt to resend the byte
 			ucLoopCount--;
 
-			// If the error count reaches 5 then consider this a failure
-			if (ucErrorCount == 5)
+			// If the error count reaches the retry limit then consider this a failure
+			if (g_ucTXErrors == COMM_TX_RETRIES)
 				break;
 		}
+
+		// The CP stopped clocking
+		if (g_ucCOMM_Flags & COMM_FRAME_ERR)
+			break;
 	}
+
+	vCOMM_TimerStop(ucLength + CRC_SZ - g_ucTXBytesLeft + g_ucTXErrors,
+			g_ucTXErrors || (g_ucCOMM_Flags & COMM_FRAME_ERR));
+#else
+	if (ucCOMM_StartMessage(pBuff, ucLength) == COMM_OK)
+		ucCOMM_WaitForSend();
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Puts a byte and its parity bit in the TX shift register
+//!
+//! The first bit is driven on the data line right away, the clock is low
+//! between bytes.
+//!   \param ucTXChar The 8-bit value to send
+//!   \return None
+///////////////////////////////////////////////////////////////////////////////
+static void vCOMM_LoadTXByte(uint8 ucTXChar)
+{
+	g_uiTXShift = (uint16)(ucTXChar | (ucCOMM_Parity(ucTXChar) << 8));
+	g_ucTXBitsLeft = 9;
+	g_ucTXState = COMM_TX_BITS;
+
+	if (g_uiTXShift & 0x01)
+		P_SDA_OUT |= SDA_PIN;
+	else
+		P_SDA_OUT &= ~SDA_PIN;
+	g_uiTXShift >>= 1;
+
+	P_SDA_DIR |= SDA_PIN;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Starts sending a data message from the SCL interrupt
+//!
+//! Puts the first bit on the line and returns. PORT2_ISR() shifts out the
+//! rest as the CP clocks it and computes the CRC as the bytes go out, writing
+//! it to the buffer after the last payload byte is acked. A nacked
+//! byte is sent again and after \ref COMM_TX_RETRIES nacks the rest of the
+//! message is dropped, as vCOMM_SendMessage() always did. The buffer must
+//! not change until COMM_TX_DONE is set, the CPU is free to sleep or work
+//! meanwhile.
+//!   \param pBuff Pointer to the message to send; ucLength Length without the CRC
+//!   \return COMM_OK, or COMM_ERROR if a message is already being sent
+//!   \sa ucCOMM_WaitForSend()
+///////////////////////////////////////////////////////////////////////////////
+uint8 ucCOMM_StartMessage(volatile uint8 * pBuff, uint8 ucLength)
+{
+	// If we are already busy, return
+	if (g_ucCOMM_Flags & COMM_TX_BUSY)
+		return COMM_ERROR;
+
+	// add the CRC bytes to the length
+	ucLength += CRC_SZ;
+
+	// The CRC is computed as the bytes go out
+	vCRC16_init(g_ucaTXCRC);
+
+	g_pucTXBuffer = pBuff;
+	g_ucTXLength = ucLength;
+	g_ucTXBytesLeft = ucLength;
+	g_ucTXErrors = 0;
+	g_ucCOMM_Flags &= ~(COMM_TX_DONE | COMM_FRAME_ERR);
+	g_ucCOMM_Flags |= COMM_TX_BUSY;
+
+	// Interrupt on falling edges of the SCL line
+	P_SCL_IES |= SCL_PIN;
+	P_SCL_IFG &= ~SCL_PIN;
+
+	vCOMM_LoadTXByte(*g_pucTXBuffer);
+
+	vCOMM_TimerStart();
+	P_SCL_IE |= SCL_PIN;
+
+	return COMM_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Sleeps in LPM0 until the message started by ucCOMM_StartMessage() is sent
+//!
+//!   \param None
+//!   \return COMM_OK, or COMM_ACK_ERR if the message was cut short by nacks
+//!   or a stalled clock
+///////////////////////////////////////////////////////////////////////////////
+uint8 ucCOMM_WaitForSend(void)
+{
+	__disable_interrupt();
+	while (g_ucCOMM_Flags & COMM_TX_BUSY) {
+		__bis_SR_register(GIE + LPM0_bits);
+		__disable_interrupt();
+	}
+	__enable_interrupt();
+
+	vCOMM_TimerStop(g_ucTXLength - g_ucTXBytesLeft + g_ucTXErrors,
+			g_ucTXErrors || (g_ucCOMM_Flags & COMM_FRAME_ERR));
+
+	if (g_ucTXBytesLeft)
+		return COMM_ACK_ERR;
+
+	return COMM_OK;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -502,8 +910,8 @@ uint8 ucCOMM_GrabMessageFromBuffer(volatile uint8 * pucBuff)
 	if (ucLength > MAXMSGLEN)
 		return COMM_BUFFER_UNDERFLOW;
 
-	// Check the CRC of the message
-	if (!ucCRC16_compute_msg_CRC(CRC_FOR_MSG_TO_REC, g_ucaRXBuffer, g_ucaRXBuffer[MSG_LEN_IDX] + CRC_SZ))
+	// Check the CRC of the message, computed as it was received
+	if (!ucCRC16_final(g_ucaRXCRC))
 		return COMM_ERROR;
 
 	for (ucLoopCount = 0x00; ucLoopCount < ucLength; ucLoopCount++)
@@ -515,6 +923,243 @@ uint8 ucCOMM_GrabMessageFromBuffer(volatile uint8 * pucBuff)
 	return COMM_OK;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Detects the start condition on the SDA line
+//!
+//! A falling SDA edge while SCL is high is a start condition, the core is
+//! woken from ucCOMM_WaitForStartCondition(). Other SDA edges leave it asleep.
+//! The SCL flag is armed for rising edges and cleared with the start, so
+//! the pickup can tell whether the CP has clocked data bits since.
+//!   \param None
+//!   \return None
+///////////////////////////////////////////////////////////////////////////////
+#pragma vector=PORT1_VECTOR
+__interrupt void PORT1_ISR(void)
+{
+	if (P_SDA_IFG & SDA_PIN) {
+		P_SDA_IFG &= ~SDA_PIN;
+
+		if (P_SCL_IN & SCL_PIN) {
+			g_ucCOMM_Flags |= COMM_START_CONDITION;
+			P_SCL_IES &= ~SCL_PIN;
+			P_SCL_IFG &= ~SCL_PIN;
+			__bic_SR_register_on_exit(LPM3_bits);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Drops a message the CP stopped clocking
+//!
+//! Timer B overflows every 131 ms while a message is on the bus. If no
+//! byte was received, sent or nacked since the last overflow the CP has
+//! stopped or an edge was missed, so the message is dropped with
+//! COMM_FRAME_ERR set: the data line is released, whoever waits for the
+//! message is woken and start detection is armed again for the next start
+//! condition.
+//!   \param None
+//!   \return None
+///////////////////////////////////////////////////////////////////////////////
+#pragma vector=TIMERB1_VECTOR
+__interrupt void TIMERB1_ISR(void)
+{
+	uint8 ucProgress;
+
+	if (TBIV != TBIV_TBIFG)
+		return;
+
+	g_ucCOMM_TimerWrapped = 1;
+
+	// Still moving, just slow
+	ucProgress = (uint8)(g_ucRXBufferIndex - g_ucTXBytesLeft + g_ucTXErrors);
+	if (ucProgress != g_ucCOMM_Progress) {
+		g_ucCOMM_Progress = ucProgress;
+		return;
+	}
+
+	// Release the bus and stop the timer
+	P_SCL_IE &= ~SCL_PIN;
+	P_SDA_DIR &= ~SDA_PIN;
+	TBCTL &= ~(MC0 | MC1 | TBIE);
+
+	g_ucCOMM_Flags &= ~(COMM_RX_BUSY | COMM_TX_BUSY | COMM_START_CONDITION);
+	g_ucCOMM_Flags |= COMM_FRAME_ERR | COMM_RX_DONE | COMM_TX_DONE;
+
+	// Catch the next start condition
+	P_SDA_IFG &= ~SDA_PIN;
+	P_SDA_IE |= SDA_PIN;
+
+	__bic_SR_register_on_exit(LPM0_bits);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Handles the interrupt line and the SCL edges of a message
+//!
+//! The interrupt line wakes the core for an event. While a message is
+//! received every armed SCL edge advances the receive state machine, which
+//! follows the same edges as ucCOMM_ReceiveByte(): 8 data bits and the
+//! parity bit on rising edges, the ack driven on the next falling edge and
+//! released on the one after. The CPU is only woken once the header length
+//! plus the CRC has been received.
+//!
+//! While a message is sent the transmit state machine follows the edges of
+//! ucCOMM_SendByte(): the next bit goes out after each of 9 falling edges,
+//! the ack is sampled on the rising edge after and the next byte is loaded
+//! on the falling edge that ends the ack bit.
+//!
+//! Writing PxIES can set PxIFG, so the flag is cleared after every edge
+//! select change. The next real edge is half a clock period away.
+//!   \param None
+//!   \return None
+///////////////////////////////////////////////////////////////////////////////
+#pragma vector=PORT2_VECTOR
+__interrupt void PORT2_ISR(void)
+{
+	// Dedicated interrupt line
+	if (P_INT_IFG & INT_PIN) {
+		P_INT_IFG &= ~INT_PIN;
+		__bic_SR_register_on_exit(LPM3_bits);
+	}
+
+	if (!(P_SCL_IE & SCL_PIN) || !(P_SCL_IFG & SCL_PIN))
+		return;
+	P_SCL_IFG &= ~SCL_PIN;
+
+#ifndef COMM_TX_POLLED
+	if (g_ucCOMM_Flags & COMM_TX_BUSY) {
+
+		// Data and parity bits, the next one goes out after the falling clock
+		if (g_ucTXState == COMM_TX_BITS) {
+			if (--g_ucTXBitsLeft != 0) {
+				if (g_uiTXShift & 0x01)
+					P_SDA_OUT |= SDA_PIN;
+				else
+					P_SDA_OUT &= ~SDA_PIN;
+				g_uiTXShift >>= 1;
+
+				// The parity bit lasts a whole clock, run the byte through the CRC
+				if (g_ucTXBitsLeft == 1 && g_ucTXBytesLeft > CRC_SZ) {
+					g_ucaTXCRCNext[CRC16_HI] = g_ucaTXCRC[CRC16_HI];
+					g_ucaTXCRCNext[CRC16_LO] = g_ucaTXCRC[CRC16_LO];
+					vCRC16_updateByte(*g_pucTXBuffer, g_ucaTXCRCNext);
+				}
+			}
+			else {
+				// Next bit is ack so release the data line for the rising clock
+				P_SDA_DIR &= ~SDA_PIN;
+				P_SCL_IES &= ~SCL_PIN;
+				P_SCL_IFG &= ~SCL_PIN;
+				g_ucTXState = COMM_TX_ACK;
+			}
+		}
+		// Ack bit, a high data line is a nack
+		else if (g_ucTXState == COMM_TX_ACK) {
+			g_ucTXNack = (P_SDA_IN & SDA_PIN);
+			P_SCL_IES |= SCL_PIN;
+			P_SCL_IFG &= ~SCL_PIN;
+			g_ucTXState = COMM_TX_ACK_END;
+		}
+		// End of the ack bit, resend a nacked byte or move to the next one
+		else {
+			if (!g_ucTXNack) {
+				g_pucTXBuffer++;
+				g_ucTXBytesLeft--;
+
+				// Keep the CRC of the acked bytes, the CRC of the message goes out next
+				g_ucaTXCRC[CRC16_HI] = g_ucaTXCRCNext[CRC16_HI];
+				g_ucaTXCRC[CRC16_LO] = g_ucaTXCRCNext[CRC16_LO];
+				if (g_ucTXBytesLeft == CRC_SZ) {
+					g_pucTXBuffer[0] = g_ucaTXCRC[CRC16_HI];
+					g_pucTXBuffer[1] = g_ucaTXCRC[CRC16_LO];
+				}
+			}
+			else {
+				g_ucTXErrors++;
+			}
+
+			// Whole message or too many nacks, stop and wake the core
+			if (g_ucTXBytesLeft == 0 || g_ucTXErrors == COMM_TX_RETRIES) {
+				P_SCL_IE &= ~SCL_PIN;
+				g_ucCOMM_Flags &= ~COMM_TX_BUSY;
+				g_ucCOMM_Flags |= COMM_TX_DONE;
+				__bic_SR_register_on_exit(LPM0_bits);
+				return;
+			}
+
+			vCOMM_LoadTXByte(*g_pucTXBuffer);
+		}
+		return;
+	}
+#endif
+
+#ifndef COMM_RX_POLLED
+	// Data bits, sample the data line
+	if (g_ucRXState == COMM_RX_DATA) {
+		g_ucRXByte >>= 1;
+		if (P_SDA_IN & SDA_PIN)
+			g_ucRXByte |= 0x80;
+
+		if (--g_ucRXBitsLeft == 0)
+			g_ucRXState = COMM_RX_PARITY;
+	}
+	// Parity bit, a mismatch leaves ucRXParityBit set
+	else if (g_ucRXState == COMM_RX_PARITY) {
+		ucRXParityBit = ucCOMM_Parity(g_ucRXByte);
+		if (P_SDA_IN & SDA_PIN)
+			ucRXParityBit ^= 0x01;
+
+		P_SCL_IES |= SCL_PIN;
+		P_SCL_IFG &= ~SCL_PIN;
+		g_ucRXState = COMM_RX_ACK;
+	}
+	// Ack on matching parity, else nack
+	else if (g_ucRXState == COMM_RX_ACK) {
+		if (ucRXParityBit)
+			P_SDA_OUT |= SDA_PIN;
+		else
+			P_SDA_OUT &= ~SDA_PIN;
+		P_SDA_DIR |= SDA_PIN;
+		g_ucRXState = COMM_RX_ACK_END;
+
+		// The ack lasts a whole clock, run the byte through the CRC
+		vCRC16_updateByte(g_ucRXByte, g_ucaRXCRC);
+	}
+	// End of the ack bit, store the byte
+	else {
+		P_SDA_DIR &= ~SDA_PIN;
+
+		if (ucRXParityBit)
+			g_ucCOMM_Flags |= COMM_PARITY_ERR;
+
+		g_ucaRXBuffer[g_ucRXBufferIndex++] = g_ucRXByte;
+
+		// The header gives the size of the message
+		if (g_ucRXBufferIndex == SP_HEADERSIZE) {
+			g_ucRXMessageSize = g_ucaRXBuffer[MSG_LEN_IDX] + CRC_SZ;
+
+			if (g_ucRXMessageSize > MAXMSGLEN || g_ucRXMessageSize < SP_HEADERSIZE) {
+				g_ucCOMM_Flags |= COMM_FRAME_ERR;
+				g_ucRXMessageSize = SP_HEADERSIZE;
+			}
+		}
+
+		// Whole message, stop and wake the core
+		if (g_ucRXBufferIndex >= g_ucRXMessageSize) {
+			P_SCL_IE &= ~SCL_PIN;
+			g_ucCOMM_Flags &= ~COMM_RX_BUSY;
+			g_ucCOMM_Flags |= COMM_RX_DONE;
+			__bic_SR_register_on_exit(LPM0_bits);
+			return;
+		}
+
+		g_ucRXBitsLeft = 8;
+		P_SCL_IES &= ~SCL_PIN;
+		P_SCL_IFG &= ~SCL_PIN;
+		g_ucRXState = COMM_RX_DATA;
+	}
+#endif
+}
+
 //! @}
 //! @}
 
@@ -125,12 +125,143 @@
 //! \def COMM_START_CONDITION
 //! \brief Bit define - Indicates a start bit has been received
 #define COMM_START_CONDITION 0x10
+//! \def COMM_RX_DONE
+//! \brief Bit define - Indicates the SCL interrupt has received a whole message
+#define COMM_RX_DONE 0x20
+//! \def COMM_FRAME_ERR
+//! \brief Bit define - Indicates a message header with an invalid length, or
+//! a message dropped by the timeout after the CP stopped clocking
+#define COMM_FRAME_ERR 0x40
+//! \def COMM_TX_DONE
+//! \brief Bit define - Indicates the SCL interrupt has sent the whole message
+#define COMM_TX_DONE 0x80
+//! @}
+
+//! \def COMM_TX_RETRIES
+//! \brief Nacked bytes after which the rest of a message is dropped
+#define COMM_TX_RETRIES 5
+
+//! \name Receive Configuration
+//! Both are off by default: messages go through PORT2_ISR(), which frees
+//! the CPU between edges but caps SCL at about 100 kHz (see Edge Budget).
+//! Define them when the rate ceiling matters more, the polled loops keep
+//! the CPU busy for the whole message but reach about 260 kHz.
+//! @{
+//! \def COMM_RX_POLLED
+//! \brief Define to receive messages with the polled ucCOMM_ReceiveByte()
+//! loop instead of the SCL interrupt state machine
+//#define COMM_RX_POLLED
+//! \def COMM_TX_POLLED
+//! \brief Define to send messages with the polled ucCOMM_SendByte() loop
+//! instead of the SCL interrupt state machine
+//#define COMM_TX_POLLED
+//! @}
+
+//! \name Edge Budget
+//! Worst case MCLK cycles spent on one SCL edge, counted from the
+//! instructions with SDA on BIT1 and SCL on BIT2 (both constant generator
+//! values). Each SCL phase, high and low, has to last at least this long.
+//!
+//! Once per byte the edge that starts the parity bit (sending) or the ack
+//! bit (receiving) also runs the byte through the streaming CRC, which
+//! takes CRC16_BYTE_CYCLES (see crc.h). The next armed edge is a whole
+//! period away, so the period has to cover that edge and the CRC as well.
+//! The shortest period is the larger of the two bounds, at 16 MHz with
+//! the default table kernel:
+//!
+//!	polled:	max(2 x 26, 26 + 35) = 61 cycles, about 260 kHz
+//!	ISR:	max(2 x 80, 80 + 35) = 160 cycles, about 100 kHz
+//!
+//! The nibble kernel (95 cycles) would lower the polled ceiling to about
+//! 130 kHz and the ISR one to about 90 kHz. The timeout overflow of
+//! TIMERB1_ISR() can delay one edge every 131 ms. The rate test
+//! (vCOMM_RateTest()) measures the real ceiling.
+//! @{
+//! \def COMM_POLLED_EDGE_CYCLES
+//! \brief Polled routines: the wait loop, which also checks the timeout,
+//! sees the edge up to 12 cycles late, SDA is driven or sampled within 10
+//! more and the flag cleared in 4
+#define COMM_POLLED_EDGE_CYCLES	26
+//! \def COMM_ISR_EDGE_CYCLES
+//! \brief PORT2_ISR() including interrupt entry, register saves and RETI
+#define COMM_ISR_EDGE_CYCLES	80
+//! \def COMM_PERIOD_CYCLES
+//! \brief Shortest SCL period for an edge cost, the CRC edge included
+#define COMM_PERIOD_CYCLES(edge)	(((edge) > CRC16_BYTE_CYCLES) ? 2 * (edge) : (edge) + CRC16_BYTE_CYCLES)
+//! \def COMM_POLLED_PERIOD_CYCLES
+//! \brief Shortest SCL period of the polled routines
+#define COMM_POLLED_PERIOD_CYCLES	COMM_PERIOD_CYCLES(COMM_POLLED_EDGE_CYCLES)
+//! \def COMM_ISR_PERIOD_CYCLES
+//! \brief Shortest SCL period of PORT2_ISR()
+#define COMM_ISR_PERIOD_CYCLES	COMM_PERIOD_CYCLES(COMM_ISR_EDGE_CYCLES)
+//! @}
+
+//! \name Bit Loop Macros
+//! The polled byte routines are unrolled from these, one SCL edge each.
+//! @{
+//! \def COMM_SCL_WAIT
+//! \brief Waits for the armed SCL edge or the timeout, the flag is left set
+#define COMM_SCL_WAIT()				while (!(P_SCL_IFG & SCL_PIN) && !(g_ucCOMM_Flags & COMM_FRAME_ERR))
+//! \def COMM_SDA_DRIVE
+//! \brief Drives SDA high if bit is non zero else low
+#define COMM_SDA_DRIVE(bit)			do { if (bit) P_SDA_OUT |= SDA_PIN; else P_SDA_OUT &= ~SDA_PIN; } while (0)
+//! \def COMM_TX_NEXT
+//! \brief Waits for a falling SCL edge, drives the next bit and clears the flag
+#define COMM_TX_NEXT(bit)			do { COMM_SCL_WAIT(); COMM_SDA_DRIVE(bit); P_SCL_IFG &= ~SCL_PIN; } while (0)
+//! \def COMM_RX_NEXT
+//! \brief Waits for a rising SCL edge, sets mask in var if SDA is high and clears the flag
+#define COMM_RX_NEXT(var, mask)		do { COMM_SCL_WAIT(); if (P_SDA_IN & SDA_PIN) (var) |= (mask); P_SCL_IFG &= ~SCL_PIN; } while (0)
+//! @}
+
+//! \name Rate Test
+//! @{
+//! \def COMM_RATE_TICK_NS
+//! \brief Timer B tick of the message timer, SMCLK/8, in ns
+#define COMM_RATE_TICK_NS		2000
+//! \def COMM_RATE_REPORT_LEN
+//! \brief Length of the rate test report
+#define COMM_RATE_REPORT_LEN	6
+//! @}
+
+//! \name Receive States
+//! States of the SCL interrupt receive state machine, one per clock edge
+//! class of a byte.
+//! @{
+//! \def COMM_RX_DATA
+//! \brief Rising edges of the 8 data bits, LSB first
+#define COMM_RX_DATA		0x00
+//! \def COMM_RX_PARITY
+//! \brief Rising edge of the parity bit
+#define COMM_RX_PARITY		0x01
+//! \def COMM_RX_ACK
+//! \brief Falling edge that ends the parity bit, the ack is driven
+#define COMM_RX_ACK			0x02
+//! \def COMM_RX_ACK_END
+//! \brief Falling edge that ends the ack bit, the byte is stored
+#define COMM_RX_ACK_END		0x03
+//! @}
+
+//! \name Transmit States
+//! States of the SCL interrupt transmit state machine.
+//! @{
+//! \def COMM_TX_BITS
+//! \brief Falling edges of the 8 data bits and the parity bit, LSB first
+#define COMM_TX_BITS		0x00
+//! \def COMM_TX_ACK
+//! \brief Rising edge of the ack bit, the ack is sampled
+#define COMM_TX_ACK			0x01
+//! \def COMM_TX_ACK_END
+//! \brief Falling edge that ends the ack bit, the next byte is loaded
+#define COMM_TX_ACK_END		0x02
 //! @}
 
 //! \name Communication Flags
 //! These are flags are used to pass information between CP and SP in the flags byte
 //! @{
 #define SHUTDOWN_BIT		0x01
+//! \def MORE_DATA_BIT
+//! \brief The SP holds more data than fit in this REPORT_DATA, the CP should request again
+#define MORE_DATA_BIT		0x02
 //! @}
 
 //! \def INT_PIN
@@ -246,6 +377,8 @@
 void vCOMM_Init(void);
 void vCOMM_Shutdown(void);
 uint8 ucCOMM_WaitForMessage(void);
+void vCOMM_RateTest(uint8 ucEnable);
+uint8 ucCOMM_RateReport(uint8 * pucReport);
 //! @}
 
 //! @name Transmit Functions
@@ -253,6 +386,8 @@ uint8 ucCOMM_WaitForMessage(void);
 //! @{
 uint8 ucCOMM_SendByte(uint8 ucChar);
 void vCOMM_SendMessage(volatile uint8 * pBuff, uint8 ucLength);
+uint8 ucCOMM_StartMessage(volatile uint8 * pBuff, uint8 ucLength);
+uint8 ucCOMM_WaitForSend(void);
 //! @}
 
 //! @name Receive Functions
@@ -267,8 +402,10 @@ uint8 ucCOMM_GrabMessageFromBuffer(volatile uint8 * pucBuff);
 //! @name Interrupt Handlers
 //! These are the interrupt handlers used by the \ref comm Module.
 //! @{
+__interrupt void PORT1_ISR(void);
 __interrupt void PORT2_ISR(void);
 __interrupt void TIMERA0_ISR(void);
+__interrupt void TIMERB1_ISR(void);
 //! @}
 
 #endif /*COMM_H_*/
@@ -4,6 +4,9 @@
 *
 * Example Table Driven CRC16 Routine using 4-bit message chunks
 *
+* The byte update can also be built with a 256 entry word table or with the
+* table free shift/XOR form, see CRC16_KERNEL in crc.h.
+*
 * V1.01 10/07/2002 wzr
 *		Modified from the original form into a package for the wizard project.
 *
@@ -22,9 +25,7 @@
 #include "crc.h"				//crc calculator
 #include "comm.h"				//msg definitions
 
-/* CRC16 "REGISTER" (IMPLEMENTED AS TWO 8BIT VALUES) */
-#define CRC16_HI 0					// index into ucaX1FLD[]
-#define CRC16_LO 1					// same
+#if CRC16_KERNEL == CRC16_KERNEL_NIBBLE
 
 /* CRC16 LOOKUP TABLES (HI & LO BYTES) FOR 4 BITS PER ITERATION. */
 const unsigned char ucCRC16_lookupHI[16] =
@@ -97,6 +98,154 @@ void vCRC16_updateByte(
 
 	}/* END: vCRC16_updateByte() */
 
+#elif CRC16_KERNEL == CRC16_KERNEL_TABLE
+
+/* CRC16 LOOKUP TABLE FOR 8 BITS PER ITERATION (ENTRY = CRC OF THE INDEX << 8) */
+const unsigned int uiCRC16_lookup[256] =
+		{
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+        0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+        0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+        0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+        0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+        0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+        0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+        0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+        0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+        0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+        0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+        0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+        0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+        0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+        0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+        0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+        0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+        0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+        0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+        0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+        0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+        0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+        0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+        0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+        0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+        0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+        0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+        0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+        0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+        0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+        0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+		};
+
+
+
+
+/***********************  vCRC16_updateByte()  *************************************
+*
+* compute the crc for a full msg byte with one lookup.
+*
+*******************************************************************************/
+
+void vCRC16_updateByte(
+		unsigned char ucByteVal,		//byte to add to CRC
+		unsigned char ucCRCarray[2]		//CRC current value
+		)
+	{
+	unsigned int uiTmp;
+
+	/* THE TOP BYTE OF THE CRC REG XOR THE MSG BYTE PICKS THE ENTRY */
+	uiTmp = uiCRC16_lookup[ucCRCarray[CRC16_HI] ^ ucByteVal];
+
+	/* SHIFT THE CRC REG LEFT 8 BITS AND XOR IN THE ENTRY */
+	ucCRCarray[CRC16_HI] = ucCRCarray[CRC16_LO] ^ (unsigned char)(uiTmp >> 8);
+	ucCRCarray[CRC16_LO] = (unsigned char)uiTmp;
+
+	return;
+
+	}/* END: vCRC16_updateByte() */
+
+#elif CRC16_KERNEL == CRC16_KERNEL_SHIFT
+
+/***********************  vCRC16_updateByte()  *************************************
+*
+* compute the crc for a full msg byte without a table.  The polynomial
+* 0x1021 has its taps at bits 12, 5 and 0, so the eight steps of the bitwise
+* form fold into a few shifts of the top byte.
+*
+*******************************************************************************/
+
+void vCRC16_updateByte(
+		unsigned char ucByteVal,		//byte to add to CRC
+		unsigned char ucCRCarray[2]		//CRC current value
+		)
+	{
+	unsigned char ucTmp;
+
+	/* XOR THE MSG BYTE INTO THE TOP BYTE OF THE CRC REG */
+	ucTmp = ucCRCarray[CRC16_HI] ^ ucByteVal;
+	ucTmp ^= ucTmp >> 4;
+
+	/* SHIFT THE CRC REG LEFT 8 BITS AND XOR IN (TMP<<12) ^ (TMP<<5) ^ TMP */
+	ucCRCarray[CRC16_HI] = ucCRCarray[CRC16_LO] ^ (unsigned char)(ucTmp << 4) ^ (ucTmp >> 3);
+	ucCRCarray[CRC16_LO] = (unsigned char)(ucTmp << 5) ^ ucTmp;
+
+	return;
+
+	}/* END: vCRC16_updateByte() */
+
+#else
+  #error "CRC16_KERNEL must be CRC16_KERNEL_NIBBLE, CRC16_KERNEL_TABLE or CRC16_KERNEL_SHIFT"
+#endif
+
+
+
+
+/***********************  vCRC16_init()  ***************************************
+*
+* Start a streaming CRC.  The register is set to 0xFFFF as per CCITT spec.
+*
+*******************************************************************************/
+
+void vCRC16_init(
+		unsigned char ucCRCarray[2]		//CRC register to init
+		)
+	{
+
+	ucCRCarray[CRC16_HI] = 0xFF;
+	ucCRCarray[CRC16_LO] = 0xFF;
+
+	return;
+
+	}/* END: vCRC16_init() */
+
+
+
+
+/***********************  ucCRC16_final()  *************************************
+*
+* End a streaming CRC of a received msg.  The CRC bytes of the msg have been
+* run through the register as well, so a good msg leaves it at zero.  For a
+* msg to send the register itself (HI then LO) is the CRC.
+*
+* RET:	1 = CRC is OK
+*		0 = CRC mismatch
+*
+*******************************************************************************/
+
+unsigned char ucCRC16_final(				/* RET:	1=CRC is OK, 0=CRC mismatch */
+		unsigned char ucCRCarray[2]		//CRC of a received msg, its CRC included
+		)
+	{
+
+	if((!ucCRCarray[CRC16_HI]) && (!ucCRCarray[CRC16_LO]))
+		{
+		return(1);	//good return
+		}
+
+	return(0);	//bad return
+
+	}/* END: ucCRC16_final() */
+
 
 
 
@@ -16,9 +16,64 @@
 #define CRC_FOR_MSG_TO_REC  0
 #define CRC_SZ 2
 
+/* CRC16 KERNELS, PICK ONE WITH CRC16_KERNEL.  ALL GIVE 0x29B1 FOR "123456789".
+ * MSP430 CYCLES ARE COUNTED PER MSG BYTE FROM THE INSTRUCTIONS, CALL AND
+ * ARGUMENT LOADS INCLUDED.  HOST CYCLES ARE MEASURED BY host/crc_bench.c
+ * (x86-64, gcc -O2 -fno-inline), WHICH ALSO CHECKS EACH KERNEL AGAINST A
+ * BITWISE REFERENCE.
+ *
+ *				TABLES		MSP430	HOST
+ *	NIBBLE:	two 16 entry byte tables	 32 bytes	~95	13.9
+ *	TABLE:	one 256 entry word table	512 bytes	~35	 6.5
+ *	SHIFT:	shift/XOR, no table		  0 bytes	~50	 4.8
+ *
+ * THE HOST RANKS SHIFT FIRST BECAUSE IT SHIFTS ANY DISTANCE IN ONE
+ * INSTRUCTION.  THE MSP430 SHIFTS ONE BIT PER INSTRUCTION, SO THERE THE
+ * TABLE LOOKUP WINS.
+ *
+ * THE LINK RUNS THE UPDATE INSIDE ONE SCL PERIOD (SEE THE EDGE BUDGET IN
+ * COMM.H), SO THE TABLE KERNEL IS THE DEFAULT.  THE OTHERS SAVE FLASH AT
+ * A LOWER SCL CEILING.
+ */
+#define CRC16_KERNEL_NIBBLE	0
+#define CRC16_KERNEL_TABLE	1
+#define CRC16_KERNEL_SHIFT	2
+
+#ifndef CRC16_KERNEL
+  #define CRC16_KERNEL CRC16_KERNEL_TABLE
+#endif
+
+/* WORST CASE MCLK CYCLES OF ONE vCRC16_updateByte() CALL */
+#if CRC16_KERNEL == CRC16_KERNEL_NIBBLE
+  #define CRC16_BYTE_CYCLES 95
+#elif CRC16_KERNEL == CRC16_KERNEL_TABLE
+  #define CRC16_BYTE_CYCLES 35
+#else
+  #define CRC16_BYTE_CYCLES 50
+#endif
+
+/* CRC16 "REGISTER" (IMPLEMENTED AS TWO 8BIT VALUES) */
+#define CRC16_HI 0					// index into ucCRCarray[]
+#define CRC16_LO 1					// same
+
 
 /* ROUTINE DEFINITIONS */
 
+/* STREAMING CRC: INIT, ONE UPDATE PER BYTE AS IT IS SENT OR RECEIVED, THEN
+ * THE REGISTER IS THE CRC TO SEND OR IS CHECKED FOR ZERO AFTER RECEIVING */
+void vCRC16_init(
+		unsigned char ucCRCarray[2]		//CRC register to init
+		);
+
+void vCRC16_updateByte(
+		unsigned char ucByteVal,		//byte to add to CRC
+		unsigned char ucCRCarray[2]		//CRC current value
+		);
+
+unsigned char ucCRC16_final(				/* RET:	1=CRC is OK, 0=CRC mismatch */
+		unsigned char ucCRCarray[2]		//CRC of a received msg, its CRC included
+		);
+
 unsigned char ucCRC16_compute_msg_CRC(		/* RET:	1=CRC is OK, 0=CRC mismatch */
 		unsigned char ucMsgFlag,	//send msg or receive msg flag
 		volatile unsigned char *ucMSGBuff, 				//pointer to the message
@@ -109,6 +109,14 @@
 //! \def REQUEST_SENSOR_TYPE
 //! \brief This packet is used by the CP board to request the sensor type
 #define REQUEST_SENSOR_TYPE			0x0D
+
+//! \def REQUEST_CAL
+//! \brief This packet is used by the CP board to read the calibration table
+#define REQUEST_CAL			0x0E
+
+//! \def SET_CAL
+//! \brief This packet is used by the CP board to write the calibration table
+#define SET_CAL			0x0F
 //! @}
 
 //! \def MAXMSGLEN
@@ -119,6 +127,10 @@
 //! \brief The size of the header portion of the SP message
 #define SP_HEADERSIZE		4
 
+//! \def SP_MAXPAYLOADLEN
+//! \brief The largest payload that fits in a message along with the header and the 2 CRC bytes
+#define SP_MAXPAYLOADLEN	(MAXMSGLEN - SP_HEADERSIZE - 2)
+
 //! @name Message Indices
 //! \brief Indices for elements of a message
 //! @{
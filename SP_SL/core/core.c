@@ -146,7 +146,8 @@ unsigned int unCORE_GetVoltage(void)
 	ADC12CTL0 &= ~ENC;
 	ADC12CTL0 &= ~(REFON + ADC12ON); // turn off A/D to save power
 
-	rt_volts = (rt_volts * 5) / 41;
+	// rt_volts * 5 / 41 as a multiply by the reciprocal, exact for 12 bit inputs
+	rt_volts = (int) (ulFIXMATH_MulU16(rt_volts, FIXMATH_RECIP(41, 17) * 5) >> 17);
 	return (rt_volts);
 }
 
@@ -283,6 +284,10 @@ void vCORE_Run(void)
 
 						unTransducerReturn = 0; //default return value to 0
 
+						// All transducers of the packet run in one session so the application
+						// can keep its hardware up between them
+						vMain_SessionBegin();
+
 						// Read through the length of the message and execute commands as they are read
 						for (ucMsgBuffIdx = MSG_PAYLD_IDX; ucMsgBuffIdx < ucaMsg_Buff[MSG_LEN_IDX];) {
 							// Get the transducer number and the parameter length
@@ -296,6 +301,8 @@ void vCORE_Run(void)
 							// Dispatch to perform the task, pass all values needed to populate the data
 							unTransducerReturn |= uiMainDispatch(ucCmdTransNum, ucCmdParamLen, ucParam);
 						}
+
+						vMain_SessionEnd();
 					break; //END COMMAND_PKT
 
 					case REQUEST_DATA:
@@ -317,6 +324,10 @@ void vCORE_Run(void)
 						// Load the message buffer with data.  The fetch function returns length
 						ucaMsg_Buff[MSG_LEN_IDX] = SP_HEADERSIZE + ucMain_FetchData(&ucaMsg_Buff[MSG_PAYLD_IDX]);
 
+						// Ask the CP to come back for what did not fit
+						if (ucMain_DataPending())
+							ucaMsg_Buff[MSG_FLAGS_IDX] |= MORE_DATA_BIT;
+
 						// Send the message
 						vCOMM_SendMessage(ucaMsg_Buff, ucaMsg_Buff[MSG_LEN_IDX]);
 
@@ -446,6 +457,47 @@ void vCORE_Run(void)
 						// Send the message
 						vCOMM_SendMessage(ucaMsg_Buff, ucaMsg_Buff[MSG_LEN_IDX]);
 
+					break;
+
+						// The CP reads the calibration table
+					case REQUEST_CAL:
+						ucaMsg_Buff[MSG_TYP_IDX] = REQUEST_CAL;
+						ucaMsg_Buff[MSG_VER_IDX] = SP_DATAMESSAGE_VERSION;
+
+						if (ucMain_ShutdownAllowed() == 1)
+							ucaMsg_Buff[MSG_FLAGS_IDX] |= SHUTDOWN_BIT;
+						else
+							ucaMsg_Buff[MSG_FLAGS_IDX] = 0;
+
+						// The application knows the format and length of its table
+						ucaMsg_Buff[MSG_LEN_IDX] = SP_HEADERSIZE + ucMain_GetCalTable(&ucaMsg_Buff[MSG_PAYLD_IDX]);
+
+						// Send the message
+						vCOMM_SendMessage(ucaMsg_Buff, ucaMsg_Buff[MSG_LEN_IDX]);
+					break;
+
+						// The CP writes the calibration table
+					case SET_CAL:
+						ucaMsg_Buff[MSG_TYP_IDX] = SET_CAL;
+						ucaMsg_Buff[MSG_VER_IDX] = SP_DATAMESSAGE_VERSION;
+
+						if (ucMain_ShutdownAllowed() == 1)
+							ucaMsg_Buff[MSG_FLAGS_IDX] |= SHUTDOWN_BIT;
+						else
+							ucaMsg_Buff[MSG_FLAGS_IDX] = 0;
+
+						// Write the table, then echo what was stored
+						if (ucMain_SetCalTable(&ucaMsg_Buff[MSG_PAYLD_IDX], ucaMsg_Buff[MSG_LEN_IDX] - SP_HEADERSIZE)) {
+							// Report an error if the table was rejected or the write was unsuccessful
+							ucaMsg_Buff[MSG_TYP_IDX] = REPORT_ERROR;
+							ucaMsg_Buff[MSG_LEN_IDX] = SP_HEADERSIZE;
+						}
+						else {
+							ucaMsg_Buff[MSG_LEN_IDX] = SP_HEADERSIZE + ucMain_GetCalTable(&ucaMsg_Buff[MSG_PAYLD_IDX]);
+						}
+
+						// Send the message
+						vCOMM_SendMessage(ucaMsg_Buff, ucaMsg_Buff[MSG_LEN_IDX]);
 					break;
 
 						// The CP commands the sensor types to be retrieved
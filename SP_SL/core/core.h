@@ -87,6 +87,7 @@
   #include "comm/comm.h"
   #include "changeable_core_header.h"
   #include "flash.h"
+  #include "fixmath.h"
 
 
 #endif /*CORE_H_*/
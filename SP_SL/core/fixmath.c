@@ -0,0 +1,168 @@
+///////////////////////////////////////////////////////////////////////////////
+//! \file fixmath.c
+//! \brief Fixed-point arithmetic on the hardware multiplier
+//!
+//! Every routine writes the multiplier registers with interrupts held off,
+//! so an ISR using the multiplier cannot corrupt a result in between. The
+//! result registers are ready 3 cycles after OP2 is written, which the
+//! compiler's next instructions always cover.
+//!
+//! @addtogroup core
+//! @{
+//!
+
+#include <msp430x23x.h>
+#include "core.h"
+#include "fixmath.h"
+
+//////////////////////////lFIXMATH_MulS16()/////////////////////////////////
+//! \brief Multiplies two signed 16-bit numbers
+//!
+//! \param iA, iB the factors
+//! \return the full 32-bit product
+//////////////////////////////////////////////////////////////////////////
+int32 lFIXMATH_MulS16(int16 iA, int16 iB)
+{
+	uint16 unSR;
+	int32 lResult;
+
+	unSR = __get_SR_register() & GIE;
+	__disable_interrupt();
+
+	MPYS = iA;
+	OP2 = iB;
+	lResult = ((int32) RESHI << 16) | RESLO;
+
+	__bis_SR_register(unSR);
+	return lResult;
+}
+
+//////////////////////////ulFIXMATH_MulU16()/////////////////////////////////
+//! \brief Multiplies two unsigned 16-bit numbers
+//!
+//! \param unA, unB the factors
+//! \return the full 32-bit product
+//////////////////////////////////////////////////////////////////////////
+uint32 ulFIXMATH_MulU16(uint16 unA, uint16 unB)
+{
+	uint16 unSR;
+	uint32 ulResult;
+
+	unSR = __get_SR_register() & GIE;
+	__disable_interrupt();
+
+	MPY = unA;
+	OP2 = unB;
+	ulResult = ((uint32) RESHI << 16) | RESLO;
+
+	__bis_SR_register(unSR);
+	return ulResult;
+}
+
+//////////////////////////iFIXMATH_MulQ15()/////////////////////////////////
+//! \brief Multiplies two Q15 numbers
+//!
+//! \param iA, iB the factors in Q15
+//! \return the product in Q15, (RESHI:RESLO) >> 15
+//////////////////////////////////////////////////////////////////////////
+int16 iFIXMATH_MulQ15(int16 iA, int16 iB)
+{
+	uint16 unSR;
+	int16 iResult;
+
+	unSR = __get_SR_register() & GIE;
+	__disable_interrupt();
+
+	MPYS = iA;
+	OP2 = iB;
+	iResult = (int16) ((RESHI << 1) | (RESLO >> 15));
+
+	__bis_SR_register(unSR);
+	return iResult;
+}
+
+//////////////////////////lFIXMATH_MulQ14()/////////////////////////////////
+//! \brief Multiplies a 32-bit number by a Q14 coefficient
+//!
+//! The number is split into a signed high part and 15 low bits so both
+//! partial products fit the 16x16 multiplier.
+//!
+//! \param iCoef the coefficient in Q14; lX the number, |lX| < 2^30
+//! \return (iCoef * lX) >> 14
+//////////////////////////////////////////////////////////////////////////
+int32 lFIXMATH_MulQ14(int16 iCoef, int32 lX)
+{
+	return (lFIXMATH_MulS16(iCoef, (int16) (lX >> 15)) << 1)
+	       + (lFIXMATH_MulS16(iCoef, (int16) (lX & 0x7FFF)) >> 14);
+}
+
+//////////////////////////unFIXMATH_ScaleQ14()//////////////////////////////
+//! \brief Scales a number by an unsigned Q14 factor (0 to 4)
+//!
+//! \param unX the number; unScale the factor in Q14
+//! \return (unX * unScale) >> 14, saturated to 0xFFFF
+//////////////////////////////////////////////////////////////////////////
+uint16 unFIXMATH_ScaleQ14(uint16 unX, uint16 unScale)
+{
+	uint32 ulResult;
+
+	ulResult = ulFIXMATH_MulU16(unX, unScale) >> 14;
+	if (ulResult > 0xFFFF)
+		return 0xFFFF;
+
+	return (uint16) ulResult;
+}
+
+//////////////////////////ulFIXMATH_MacSat()/////////////////////////////////
+//! \brief Saturating multiply-accumulate
+//!
+//! The accumulator is loaded into RESHI:RESLO and the product added by the
+//! MAC register. SUMEXT holds the carry out of the 32-bit sum.
+//!
+//! \param ulAcc the accumulator; unA, unB the factors
+//! \return ulAcc + unA * unB, saturated to 0xFFFFFFFF
+//////////////////////////////////////////////////////////////////////////
+uint32 ulFIXMATH_MacSat(uint32 ulAcc, uint16 unA, uint16 unB)
+{
+	uint16 unSR;
+	uint32 ulResult;
+
+	unSR = __get_SR_register() & GIE;
+	__disable_interrupt();
+
+	RESLO = (uint16) ulAcc;
+	RESHI = (uint16) (ulAcc >> 16);
+	MAC = unA;
+	OP2 = unB;
+	ulResult = ((uint32) RESHI << 16) | RESLO;
+	if (SUMEXT)
+		ulResult = 0xFFFFFFFF;
+
+	__bis_SR_register(unSR);
+	return ulResult;
+}
+
+//////////////////////////ulFIXMATH_Average()////////////////////////////////
+//! \brief Divides a sum by a count
+//!
+//! Power of two counts, which every default and oversampled read uses,
+//! only need a shift. Other counts fall back to the library division.
+//!
+//! \param ulSum the sum; unCount the count, not 0
+//! \return ulSum / unCount
+//////////////////////////////////////////////////////////////////////////
+uint32 ulFIXMATH_Average(uint32 ulSum, uint16 unCount)
+{
+	uint8 ucShift;
+
+	if (unCount & (unCount - 1))
+		return ulSum / unCount;
+
+	ucShift = 0;
+	while (unCount >>= 1)
+		ucShift++;
+
+	return ulSum >> ucShift;
+}
+
+//! @}
@@ -0,0 +1,39 @@
+///////////////////////////////////////////////////////////////////////////////
+//! \file fixmath.h
+//! \brief Header file for the fixed-point math module
+//!
+//! The MSP430 has no divide instruction, a 32-bit division is a library
+//! loop of several hundred cycles. These helpers scale with the hardware
+//! multiplier instead: products and multiply-accumulates take a few
+//! cycles, division by a constant becomes a multiply by its reciprocal
+//! and averages over power of two counts become shifts.
+//!
+//! host/fixmath_bench.c checks the helpers and the reciprocal constants of
+//! the tree on a PC and times them against division.
+//!
+//! @addtogroup core
+//! @{
+
+#ifndef FIXMATH_H_
+#define FIXMATH_H_
+
+//! @name Reciprocal constants
+//! Division by a constant d as (x * FIXMATH_RECIP(d)) >> s. The shift has
+//! to be large enough for the result to be exact over the range of x.
+//! @{
+//! \def FIXMATH_RECIP
+//! \brief Reciprocal of d in Q(s), rounded up
+#define FIXMATH_RECIP(d, s)	((uint16)(((1UL << (s)) + (d) - 1) / (d)))
+//! @}
+
+// fixmath.c function prototypes
+int32 lFIXMATH_MulS16(int16 iA, int16 iB);
+uint32 ulFIXMATH_MulU16(uint16 unA, uint16 unB);
+int16 iFIXMATH_MulQ15(int16 iA, int16 iB);
+int32 lFIXMATH_MulQ14(int16 iCoef, int32 lX);
+uint16 unFIXMATH_ScaleQ14(uint16 unX, uint16 unScale);
+uint32 ulFIXMATH_MacSat(uint32 ulAcc, uint16 unA, uint16 unB);
+uint32 ulFIXMATH_Average(uint32 ulSum, uint16 unCount);
+
+#endif /*FIXMATH_H_*/
+//! @}
@@ -380,5 +380,75 @@ void vFlash_GetHID(uint16 *uiHID)
 
 }
 
-//! @}
+////////////////////////// vFlash_GetCal() ////////////////////////////////////
+//! \brief Gets the calibration table from flash.  The table follows the HID in
+//! info memory sector D, its format is up to the application.
+//!
+//! \param *pucBuff, destination of the table; ucLen, length of the table in bytes
+//! \return none
+//////////////////////////////////////////////////////////////////////////
+void vFlash_GetCal(volatile uint8 *pucBuff, uint8 ucLen)
+{
+	uint8 ucIndex;
+	uint16 uiData;
+
+	//initialize the flash controller
+	vFlash_init();
+
+	if (ucLen > CAL_MAXLEN)
+		ucLen = CAL_MAXLEN;
 
+	// Read whole words and split them, the table starts on a word boundary
+	for (ucIndex = 0; ucIndex < ucLen; ucIndex += 2)
+	{
+		uiData = uiFlash_Read_Int(FLASH_INFO_D + CAL_ADDRESS + ucIndex);
+		*pucBuff++ = (uint8) uiData;
+		if (ucIndex + 1 < ucLen)
+			*pucBuff++ = (uint8) (uiData >> 8);
+	}
+}
+
+////////////////////////// ucFlash_SetCal() ////////////////////////////////////
+//! \brief Writes the calibration table to flash.  The rest of sector D,
+//! including the HID, is read back and rewritten unchanged.
+//!
+//! \param *pucBuff, the table; ucLen, length of the table in bytes
+//! \return ucErrCode
+////////////////////////////////////////////////////////////////////////////////
+uint8 ucFlash_SetCal(volatile uint8 *pucBuff, uint8 ucLen)
+{
+	uint8 ucErrCode;
+	uint16 uiSegmentData[INFO_SEGMENTLENGTH/2];
+	uint8 * pucSegment;
+	uint8 ucIndex;
+
+	if (ucLen > CAL_MAXLEN)
+		return 1;
+
+	// Assume success
+	ucErrCode = 0;
+
+	//initialize the flash controller
+	vFlash_init();
+
+	vFlash_Read_Segment(uiSegmentData, FLASH_INFO_D);
+
+	vFlash_Erase_Seg(FLASH_INFO_D);
+
+	pucSegment = (uint8 *) uiSegmentData + CAL_ADDRESS;
+	for (ucIndex = 0; ucIndex < ucLen; ucIndex++)
+	{
+		*pucSegment++ = *pucBuff++;
+	}
+
+	vFlash_Write_Segment(uiSegmentData, FLASH_INFO_D);
+
+	//if the operation failed report it to the calling function
+	if (FCTL3 & FAIL)
+	{
+		ucErrCode = 1;
+	}
+	return ucErrCode;
+}
+
+//! @}
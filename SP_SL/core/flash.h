@@ -45,6 +45,14 @@
 //! \brief The address in info memory sector D
 #define HID_ADDRESS	0
 
+//! \def CAL_ADDRESS
+//! \brief Byte offset of the calibration table in info memory sector D, right after the 4 word HID
+#define CAL_ADDRESS	8
+
+//! \def CAL_MAXLEN
+//! \brief Largest calibration table that fits in the rest of sector D
+#define CAL_MAXLEN	(INFO_SEGMENTLENGTH - CAL_ADDRESS)
+
 // flash.c function prototypes
 //! @name flash module Functions
 //! These functions handle controlling the on CPU flash memory module
@@ -53,6 +61,8 @@ void vFlash_GetBSLPW(uint8 *p_ucBuff);
 void vFlash_DisIncorrect_BSLPW_Erase(void);
 void vFlash_GetHID(uint16 *uiHID);
 uint8 ucFlash_SetHID(uint16 *uiHID);
+void vFlash_GetCal(volatile uint8 *pucBuff, uint8 ucLen);
+uint8 ucFlash_SetCal(volatile uint8 *pucBuff, uint8 ucLen);
 //flash_dco_cal
 //! @}
 
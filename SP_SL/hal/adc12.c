@@ -6,6 +6,7 @@
  */
 
 #include <msp430x23x.h>
+#include "adc12.h"
 
 //////////////////////////////////////////////////////////////////////////
 //!
@@ -33,23 +34,57 @@ void vADC12_Init(void)
   ADC12CTL0 &= ~MSC;				//clear only used for sequence
 
   // MEM CTL
-  ADC12MCTL0 |= SREF_2;				//Vr+ = Veref+ and Vr- = AVss
-  ADC12MCTL0 |= INCH_0;				//SET CH A0
-  ADC12MCTL1 |= SREF_2;				//Vr+ = Veref+ and Vr- = AVss
-  ADC12MCTL1 |= INCH_1;				//SET CH A1
-  ADC12MCTL2 |= SREF_2;				//Vr+ = Veref+ and Vr- = AVss
-  ADC12MCTL2 |= INCH_2;				//SET CH A2
-  ADC12MCTL3 |= SREF_2;				//Vr+ = Veref+ and Vr- = AVss
-  ADC12MCTL3 |= INCH_3;				//SET CH A3
-  ADC12MCTL4 |= SREF_2;				//Vr+ = Veref+ and Vr- = AVss
-  ADC12MCTL4 |= INCH_8;				//SET CH VEREF+
-  ADC12MCTL5 |= SREF_2;				//Vr+ = Veref+ and Vr- = AVss
-  ADC12MCTL5 |= INCH_9;				//SET -REF
-  ADC12MCTL6 |= SREF_2;				//Vr+ = Veref+ and Vr- = AVss
-  ADC12MCTL6 |= INCH_11;			//SET AVDD
+  vADC12_ConfigMemCtl();
 
 }
 
+//////////////////////////////////////////////////////////////////////////
+//!
+//! \brief Programs the default memory control registers
+//!
+//! ADC12MEM0-3 hold light channels A0-A3, ADC12MEM4-6 the reference and
+//! supply channels. The registers are assigned rather than OR-ed so that
+//! a previous block configuration is fully replaced. ENC must be clear.
+//!
+//! \param none
+//! \return none
+//!
+//////////////////////////////////////////////////////////////////////////
+void vADC12_ConfigMemCtl(void)
+{
+  ADC12MCTL0 = SREF_2 | INCH_0;		//Vr+ = Veref+, Vr- = AVss, CH A0
+  ADC12MCTL1 = SREF_2 | INCH_1;		//Vr+ = Veref+, Vr- = AVss, CH A1
+  ADC12MCTL2 = SREF_2 | INCH_2;		//Vr+ = Veref+, Vr- = AVss, CH A2
+  ADC12MCTL3 = SREF_2 | INCH_3;		//Vr+ = Veref+, Vr- = AVss, CH A3
+  ADC12MCTL4 = SREF_2 | INCH_8;		//Vr+ = Veref+, Vr- = AVss, CH VEREF+
+  ADC12MCTL5 = SREF_2 | INCH_9;		//Vr+ = Veref+, Vr- = AVss, -REF
+  ADC12MCTL6 = SREF_2 | INCH_11;	//Vr+ = Veref+, Vr- = AVss, AVDD
+}
+
+//////////////////////////////////////////////////////////////////////////
+//!
+//! \brief Points every memory control register at one input
+//!
+//! Used for block conversions where a repeat sequence over
+//! ADC12MEM0-ADC12MEM15 samples the same input 16 times per trigger.
+//! EOS is set on ADC12MEM15. ENC must be clear.
+//!
+//! \param ucInput	The INCH_x input channel to convert
+//! \return none
+//!
+//////////////////////////////////////////////////////////////////////////
+void vADC12_ConfigBlock(unsigned char ucInput)
+{
+  volatile unsigned char * pucMemCtl;
+  unsigned char ucIdx;
+
+  pucMemCtl = &ADC12MCTL0;
+  for (ucIdx = 0; ucIdx < ADC12_NUM_MEM; ucIdx++)
+    *pucMemCtl++ = SREF_2 | ucInput;
+
+  ADC12MCTL15 |= EOS;				//block ends on MEM15
+}
+
 void vADC12_Shutdown(void)
 {
   ADC12CTL0 = 0x0000;
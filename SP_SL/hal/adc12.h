@@ -9,11 +9,21 @@
 #define ADC12_H_
 
 
+//! \def ADC12_NUM_MEM
+//! \brief Number of conversion memory registers (ADC12MEM0-ADC12MEM15)
+#define ADC12_NUM_MEM		16
+
+//! \def ADC12_IV_MEM15
+//! \brief ADC12IV value when ADC12MEM15 (the end of a block) is loaded
+#define ADC12_IV_MEM15		0x24
+
 //! @name ADC functions
 //! These functions are for controlling the ADC
 //! @{
 void vADC12_Init(void);
 void vADC12_Shutdown(void);
+void vADC12_ConfigMemCtl(void);
+void vADC12_ConfigBlock(unsigned char ucInput);
 //! @}
 
 #endif /* ADC12_H_ */
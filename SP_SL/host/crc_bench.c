@@ -0,0 +1,145 @@
+///////////////////////////////////////////////////////////////////////////////
+//! \file crc_bench.c
+//! \brief Host vector test and cycle count benchmark of the CRC16 kernels
+//!
+//! Runs crc.c on the PC with the kernel picked by CRC16_KERNEL. It checks:
+//! - the "123456789" test vector, which must give 0x29B1;
+//! - agreement with a bitwise CCITT reference on random messages;
+//! - that ucCRC16_final() accepts every message followed by its CRC;
+//! - that it rejects every single bit error in those messages.
+//! It then times vCRC16_updateByte() over a 64 KB buffer, in host TSC
+//! cycles per byte. The MSP430 counts in crc.h are counted from the
+//! instructions, the host numbers only rank the kernels. -fno-inline
+//! keeps the call per byte, as on the target.
+//!
+//! Build and run all three kernels from this directory:
+//!
+//!	for k in 0 1 2; do gcc -O2 -fno-inline -I. -DCRC16_KERNEL=$k -o crc_bench crc_bench.c && ./crc_bench; done
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#undef NULL
+
+#include <msp430x23x.h>
+#include "../core/comm/crc.c"
+
+//! \def BENCH_MSGS
+//! \brief Random messages checked
+#define BENCH_MSGS		10000
+
+//! \def BENCH_BYTES
+//! \brief Bytes per timed run
+#define BENCH_BYTES		65536
+
+//! \brief Reads the host time stamp counter
+static unsigned long long ullBench_Tsc(void)
+{
+	unsigned int uiLo, uiHi;
+
+	__asm__ __volatile__ ("rdtsc" : "=a" (uiLo), "=d" (uiHi));
+	return ((unsigned long long) uiHi << 32) | uiLo;
+}
+
+//! \brief Bitwise CRC16-CCITT, polynomial 0x1021, register set to 0xFFFF
+static unsigned short unBench_RefCRC(const unsigned char * pucMsg, unsigned int uiLen)
+{
+	unsigned short unCRC;
+	unsigned char ucBit;
+
+	unCRC = 0xFFFF;
+	while (uiLen--) {
+		unCRC ^= (unsigned short) (*pucMsg++ << 8);
+		for (ucBit = 0; ucBit < 8; ucBit++)
+			unCRC = (unCRC & 0x8000) ? (unsigned short) ((unCRC << 1) ^ 0x1021) : (unsigned short) (unCRC << 1);
+	}
+
+	return unCRC;
+}
+
+//! \brief Runs a message through the streaming CRC of crc.c
+static unsigned short unBench_CRC(const unsigned char * pucMsg, unsigned int uiLen)
+{
+	unsigned char ucaCRC[2];
+
+	vCRC16_init(ucaCRC);
+	while (uiLen--)
+		vCRC16_updateByte(*pucMsg++, ucaCRC);
+
+	return (unsigned short) ((ucaCRC[CRC16_HI] << 8) | ucaCRC[CRC16_LO]);
+}
+
+//! \brief Checks a received message, its CRC included, as comm.c does
+static unsigned char ucBench_Final(const unsigned char * pucMsg, unsigned int uiLen)
+{
+	unsigned char ucaCRC[2];
+
+	vCRC16_init(ucaCRC);
+	while (uiLen--)
+		vCRC16_updateByte(*pucMsg++, ucaCRC);
+
+	return ucCRC16_final(ucaCRC);
+}
+
+int main(void)
+{
+	static unsigned char ucaBuff[BENCH_BYTES];
+	unsigned long long ullStart;
+	unsigned long long ullBest;
+	unsigned long long ullRun;
+	unsigned long ulBad;
+	unsigned long ulMissed;
+	unsigned short unCRC;
+	unsigned int uiMsg;
+	unsigned int uiLen;
+	unsigned int uiBit;
+	unsigned int uiIdx;
+	unsigned char ucaCRC[2];
+	unsigned char ucRun;
+
+	printf("kernel %d: \"123456789\" = 0x%04X\n", CRC16_KERNEL,
+	       unBench_CRC((const unsigned char *) "123456789", 9));
+
+	// Random messages up to MAXMSGLEN against the reference, then with
+	// their CRC appended, once intact and once for every flipped bit
+	ulBad = 0;
+	ulMissed = 0;
+	for (uiMsg = 0; uiMsg < BENCH_MSGS; uiMsg++) {
+		uiLen = 1 + rand() % (MAXMSGLEN - CRC_SZ);
+		for (uiIdx = 0; uiIdx < uiLen; uiIdx++)
+			ucaBuff[uiIdx] = (unsigned char) rand();
+
+		unCRC = unBench_CRC(ucaBuff, uiLen);
+		ulBad += unCRC != unBench_RefCRC(ucaBuff, uiLen);
+
+		ucaBuff[uiLen] = (unsigned char) (unCRC >> 8);
+		ucaBuff[uiLen + 1] = (unsigned char) unCRC;
+		ulBad += !ucBench_Final(ucaBuff, uiLen + CRC_SZ);
+
+		for (uiBit = 0; uiBit < (uiLen + CRC_SZ) * 8; uiBit++) {
+			ucaBuff[uiBit >> 3] ^= (unsigned char) (1 << (uiBit & 7));
+			ulMissed += ucBench_Final(ucaBuff, uiLen + CRC_SZ);
+			ucaBuff[uiBit >> 3] ^= (unsigned char) (1 << (uiBit & 7));
+		}
+	}
+	printf("kernel %d: %lu mismatches, %lu missed bit errors\n", CRC16_KERNEL, ulBad, ulMissed);
+
+	// Best of 5 runs over the buffer
+	for (uiIdx = 0; uiIdx < BENCH_BYTES; uiIdx++)
+		ucaBuff[uiIdx] = (unsigned char) rand();
+	ullBest = ~0ULL;
+	for (ucRun = 0; ucRun < 5; ucRun++) {
+		vCRC16_init(ucaCRC);
+		ullStart = ullBench_Tsc();
+		for (uiIdx = 0; uiIdx < BENCH_BYTES; uiIdx++)
+			vCRC16_updateByte(ucaBuff[uiIdx], ucaCRC);
+		ullRun = ullBench_Tsc() - ullStart;
+		if (ullRun < ullBest)
+			ullBest = ullRun;
+	}
+	ullBest = ullBest * 100 / BENCH_BYTES;
+	printf("kernel %d: %llu.%02llu cycles/byte (CRC %02X%02X)\n", CRC16_KERNEL,
+	       ullBest / 100, ullBest % 100, ucaCRC[CRC16_HI], ucaCRC[CRC16_LO]);
+
+	return 0;
+}
@@ -0,0 +1,221 @@
+///////////////////////////////////////////////////////////////////////////////
+//! \file fixmath_bench.c
+//! \brief Host test and cycle count benchmark of the fixed-point helpers
+//!
+//! Runs fixmath.c on the PC against the emulated multiplier of the host
+//! msp430x23x.h and checks every helper against plain C, then checks that
+//! the reciprocal constants used in the tree are exact over their input
+//! range. Last it times a division, both the host divide instruction and
+//! the shift-subtract loop the MSP430 runtime runs instead, against a
+//! reciprocal multiply and a shift, in host TSC cycles.
+//!
+//! Build and run from this directory:
+//!
+//!	gcc -O2 -I. -o fixmath_bench fixmath_bench.c && ./fixmath_bench
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// The core types at their MSP430 widths, core.h assumes a 16-bit int
+#define CORE_H_
+typedef unsigned char uint8;
+typedef signed char int8;
+typedef unsigned short uint16;
+typedef signed short int16;
+typedef unsigned int uint32;
+typedef signed int int32;
+
+#include "../core/fixmath.c"
+
+//! \def BENCH_LOOPS
+//! \brief Operations per timed loop
+#define BENCH_LOOPS		1000000
+
+//! \def CAPTURE_CHUNK_LEN
+//! \brief Same as main.c
+#define CAPTURE_CHUNK_LEN	45
+
+//! \brief Reads the host time stamp counter
+static unsigned long long ullBench_Tsc(void)
+{
+	unsigned int uiLo, uiHi;
+
+	__asm__ __volatile__ ("rdtsc" : "=a" (uiLo), "=d" (uiHi));
+	return ((unsigned long long) uiHi << 32) | uiLo;
+}
+
+//! \brief Returns a random 16-bit operand
+static uint16 unBench_Rand(void)
+{
+	return (uint16) (rand() ^ (rand() << 8));
+}
+
+//! \brief Unsigned 32/16 division as a shift-subtract loop, the way the
+//! MSP430 runtime divides without a divide instruction
+static uint32 __attribute__((noinline)) ulBench_SoftDiv(uint32 ulNum, uint16 unDen)
+{
+	uint32 ulRem;
+	uint8 ucBit;
+
+	ulRem = 0;
+	for (ucBit = 0; ucBit < 32; ucBit++) {
+		ulRem = (ulRem << 1) | (ulNum >> 31);
+		ulNum <<= 1;
+		if (ulRem >= unDen) {
+			ulRem -= unDen;
+			ulNum |= 1;
+		}
+	}
+
+	return ulNum;
+}
+
+//! \brief Checks every helper against plain C on random operands
+static unsigned long ulBench_CheckHelpers(void)
+{
+	unsigned long ulBad;
+	unsigned long ulLoop;
+	unsigned long long ullSum;
+	uint32 ulX;
+	uint16 unA, unB;
+	int32 lX;
+
+	ulBad = 0;
+	for (ulLoop = 0; ulLoop < BENCH_LOOPS; ulLoop++) {
+		unA = unBench_Rand();
+		unB = unBench_Rand();
+		ulX = ((uint32) unBench_Rand() << 16) | unBench_Rand();
+		lX = (int32) ulX >> 2;
+
+		ulBad += lFIXMATH_MulS16((int16) unA, (int16) unB) != (int32) (int16) unA * (int16) unB;
+		ulBad += ulFIXMATH_MulU16(unA, unB) != (uint32) unA * unB;
+		ulBad += iFIXMATH_MulQ15((int16) unA, (int16) unB)
+		         != (int16) (((int32) (int16) unA * (int16) unB) >> 15);
+		ulBad += lFIXMATH_MulQ14((int16) unA, lX)
+		         != (int32) (((long long) (int16) unA * lX) >> 14);
+		ulBad += unFIXMATH_ScaleQ14(unA, unB)
+		         != (((uint32) unA * unB >> 14) > 0xFFFF ? 0xFFFF : (uint16) ((uint32) unA * unB >> 14));
+
+		ullSum = (unsigned long long) ulX + (uint32) unA * unB;
+		ulBad += ulFIXMATH_MacSat(ulX, unA, unB)
+		         != (ullSum > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (uint32) ullSum);
+
+		ulBad += ulFIXMATH_Average(ulX, 16) != ulX / 16;
+		ulBad += ulFIXMATH_Average(ulX, unB | 1) != ulX / (unB | 1);
+		ulBad += ulBench_SoftDiv(ulX, unB | 1) != ulX / (unB | 1);
+	}
+
+	return ulBad;
+}
+
+//! \brief Checks the reciprocal constants of the tree over their input range
+static unsigned long ulBench_CheckRecip(void)
+{
+	unsigned long ulBad;
+	uint32 ulX;
+
+	ulBad = 0;
+
+	// core.c: battery volts, 12 bit ADC input
+	for (ulX = 0; ulX < 4096; ulX++)
+		ulBad += (ulFIXMATH_MulU16((uint16) ulX, FIXMATH_RECIP(41, 17) * 5) >> 17) != ulX * 5 / 41;
+
+	// main.c: capture chunk count, any 16-bit byte count
+	for (ulX = 0; ulX < 0x10000; ulX++)
+		ulBad += (ulFIXMATH_MulU16((uint16) ulX, FIXMATH_RECIP(CAPTURE_CHUNK_LEN, 20)) >> 20)
+		         != ulX / CAPTURE_CHUNK_LEN;
+
+	return ulBad;
+}
+
+static uint32 g_ulaBenchX[256];
+static volatile uint16 g_unBenchDiv = CAPTURE_CHUNK_LEN;
+static volatile uint32 g_ulBenchSink;
+
+//! \brief Host divide instruction by a run time divisor
+static void vBench_Divide(void)
+{
+	unsigned long ulLoop;
+	uint32 ulAcc;
+
+	ulAcc = 0;
+	for (ulLoop = 0; ulLoop < BENCH_LOOPS; ulLoop++)
+		ulAcc += g_ulaBenchX[ulLoop & 0xFF] / g_unBenchDiv;
+	g_ulBenchSink = ulAcc;
+}
+
+//! \brief Shift-subtract division
+static void vBench_SoftDivide(void)
+{
+	unsigned long ulLoop;
+	uint32 ulAcc;
+
+	ulAcc = 0;
+	for (ulLoop = 0; ulLoop < BENCH_LOOPS; ulLoop++)
+		ulAcc += ulBench_SoftDiv(g_ulaBenchX[ulLoop & 0xFF], g_unBenchDiv);
+	g_ulBenchSink = ulAcc;
+}
+
+//! \brief Reciprocal multiply, the 16-bit operand of ulFIXMATH_MulU16()
+static void vBench_Reciprocal(void)
+{
+	unsigned long ulLoop;
+	uint32 ulAcc;
+
+	ulAcc = 0;
+	for (ulLoop = 0; ulLoop < BENCH_LOOPS; ulLoop++)
+		ulAcc += ((uint32) (uint16) g_ulaBenchX[ulLoop & 0xFF] * FIXMATH_RECIP(CAPTURE_CHUNK_LEN, 20)) >> 20;
+	g_ulBenchSink = ulAcc;
+}
+
+//! \brief Power of two average
+static void vBench_Shift(void)
+{
+	unsigned long ulLoop;
+	uint32 ulAcc;
+
+	ulAcc = 0;
+	for (ulLoop = 0; ulLoop < BENCH_LOOPS; ulLoop++)
+		ulAcc += g_ulaBenchX[ulLoop & 0xFF] >> 4;
+	g_ulBenchSink = ulAcc;
+}
+
+//! \brief Times a loop, prints the best of 5 runs in host cycles per operation
+static void vBench_Time(const char * pcName, void (* pvLoop)(void))
+{
+	unsigned long long ullStart;
+	unsigned long long ullBest;
+	unsigned long long ullRun;
+	uint8 ucRun;
+
+	ullBest = ~0ULL;
+	for (ucRun = 0; ucRun < 5; ucRun++) {
+		ullStart = ullBench_Tsc();
+		pvLoop();
+		ullRun = ullBench_Tsc() - ullStart;
+		if (ullRun < ullBest)
+			ullBest = ullRun;
+	}
+
+	ullBest = ullBest * 100 / BENCH_LOOPS;
+	printf("%-13s%llu.%02llu cycles\n", pcName, ullBest / 100, ullBest % 100);
+}
+
+int main(void)
+{
+	unsigned long ulLoop;
+
+	printf("helpers:     %lu mismatches\n", ulBench_CheckHelpers());
+	printf("reciprocals: %lu mismatches\n", ulBench_CheckRecip());
+
+	for (ulLoop = 0; ulLoop < 256; ulLoop++)
+		g_ulaBenchX[ulLoop] = ((uint32) unBench_Rand() << 8) | (ulLoop & 0xFF);
+
+	vBench_Time("divide:", vBench_Divide);
+	vBench_Time("soft divide:", vBench_SoftDivide);
+	vBench_Time("reciprocal:", vBench_Reciprocal);
+	vBench_Time("shift:", vBench_Shift);
+
+	return 0;
+}
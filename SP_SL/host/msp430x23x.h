@@ -0,0 +1,92 @@
+///////////////////////////////////////////////////////////////////////////////
+//! \file msp430x23x.h
+//! \brief Host stand-in for the device header of the host test programs
+//!
+//! Lets the core modules build with gcc on a PC. The status register is a
+//! variable, and the hardware multiplier is emulated: writing OP2 marks a
+//! product as pending, and the next read of RESLO, RESHI or SUMEXT computes
+//! it in the mode picked by the last write of MPY, MPYS or MAC. Only the
+//! registers the core modules use are provided.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_MSP430X23X_H_
+#define HOST_MSP430X23X_H_
+
+//! \name Compiler Keywords
+//! @{
+#define __interrupt
+//! @}
+
+//! \name Status Register
+//! @{
+#define GIE						(0x0008)
+
+static unsigned short __attribute__((unused)) g_unHostSR = GIE;
+
+#define __get_SR_register()		(g_unHostSR)
+#define __bis_SR_register(x)	(g_unHostSR |= (x))
+#define __disable_interrupt()	(g_unHostSR &= ~GIE)
+#define __enable_interrupt()	(g_unHostSR |= GIE)
+//! @}
+
+//! \name Hardware Multiplier
+//! @{
+#define HOST_MPY				0
+#define HOST_MPYS				1
+#define HOST_MAC				2
+
+static unsigned short g_unHostOp1;
+static unsigned short g_unHostOp2;
+static unsigned short g_unaHostRes[3];		// RESLO, RESHI, SUMEXT
+static unsigned char g_ucHostMode;
+static unsigned char g_ucHostPending;
+
+static __inline unsigned short * punHOST_Op1(unsigned char ucMode)
+{
+	g_ucHostMode = ucMode;
+	return &g_unHostOp1;
+}
+
+static __inline unsigned short * punHOST_Op2(void)
+{
+	g_ucHostPending = 1;
+	return &g_unHostOp2;
+}
+
+static __inline unsigned short * punHOST_Result(unsigned char ucReg)
+{
+	unsigned long long ullAcc;
+	long lProduct;
+
+	if (g_ucHostPending) {
+		g_ucHostPending = 0;
+
+		if (g_ucHostMode == HOST_MPYS) {
+			lProduct = (long) (short) g_unHostOp1 * (short) g_unHostOp2;
+			g_unaHostRes[0] = (unsigned short) lProduct;
+			g_unaHostRes[1] = (unsigned short) ((unsigned long) lProduct >> 16);
+			g_unaHostRes[2] = (lProduct < 0) ? 0xFFFF : 0;
+		}
+		else {
+			ullAcc = (unsigned long long) g_unHostOp1 * g_unHostOp2;
+			if (g_ucHostMode == HOST_MAC)
+				ullAcc += ((unsigned long) g_unaHostRes[1] << 16) | g_unaHostRes[0];
+			g_unaHostRes[0] = (unsigned short) ullAcc;
+			g_unaHostRes[1] = (unsigned short) (ullAcc >> 16);
+			g_unaHostRes[2] = (g_ucHostMode == HOST_MAC) ? (unsigned short) (ullAcc >> 32) : 0;
+		}
+	}
+
+	return &g_unaHostRes[ucReg];
+}
+
+#define MPY						(*punHOST_Op1(HOST_MPY))
+#define MPYS					(*punHOST_Op1(HOST_MPYS))
+#define MAC						(*punHOST_Op1(HOST_MAC))
+#define OP2						(*punHOST_Op2())
+#define RESLO					(*punHOST_Result(0))
+#define RESHI					(*punHOST_Result(1))
+#define SUMEXT					(*punHOST_Result(2))
+//! @}
+
+#endif /*HOST_MSP430X23X_H_*/
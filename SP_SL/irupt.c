@@ -16,22 +16,10 @@ __interrupt void COMPARATORA_ISR(void)
 __interrupt void NMI_ISR(void)
 {}
 
-#pragma vector=PORT1_VECTOR
-__interrupt void PORT1_ISR(void)
-{}
-
 #pragma vector=TIMERA1_VECTOR
 __interrupt void TIMERA1_ISR(void)
 {}
 
-#pragma vector=TIMERB0_VECTOR
-__interrupt void TIMERB0_ISR(void)
-{}
-
-#pragma vector=TIMERB1_VECTOR
-__interrupt void TIMERB1_ISR(void)
-{}
-
 #pragma vector=USCIAB0RX_VECTOR
 __interrupt void USCIAB0RX_ISR(void)
 {}
@@ -20,12 +20,9 @@
 //!
 uint16 g_uiAveCounter;
 
-// dummy variable in light testing likely to be removed
-uint16 g_uiDummDumm;
-
 //! \var g_ucEventTrigger
 //! \brief Flag indicating that an application specific event has occured and requires handling
-unsigned char g_ucEventTrigger;
+volatile unsigned char g_ucEventTrigger;
 
 //! \var g_iVLOCal
 //! \brief Calibration constant for the VLO.
@@ -41,6 +38,15 @@ signed int g_iVLOCal;
 #define TRANSDUCER_2_LABEL_TXT "SL2             " //02
 #define TRANSDUCER_3_LABEL_TXT "SL3	            " //03
 #define TRANSDUCER_4_LABEL_TXT "SL4	            " //03
+#define TRANSDUCER_5_LABEL_TXT "SL All          " //05
+#define TRANSDUCER_6_LABEL_TXT "SL Background   " //06
+#define TRANSDUCER_7_LABEL_TXT "SL Statistics   " //07
+#define TRANSDUCER_8_LABEL_TXT "SL Dose         " //08
+#define TRANSDUCER_9_LABEL_TXT "SL Threshold    " //09
+#define TRANSDUCER_10_LABEL_TXT "SL Timing       " //10
+#define TRANSDUCER_11_LABEL_TXT "SL Capture      " //11
+#define TRANSDUCER_12_LABEL_TXT "SL Flicker      " //12
+#define TRANSDUCER_13_LABEL_TXT "SL Link Rate    " //13
 //!@}
 
 //! \def TRANSDUCER_0
@@ -58,6 +64,33 @@ signed int g_iVLOCal;
 //! \def TRANSDUCER_4
 //! \brief Transducer 4 index definition
 #define TRANSDUCER_4      0x04
+//! \def TRANSDUCER_5
+//! \brief Transducer 5 index definition
+#define TRANSDUCER_5      0x05
+//! \def TRANSDUCER_6
+//! \brief Transducer 6 index definition
+#define TRANSDUCER_6      0x06
+//! \def TRANSDUCER_7
+//! \brief Transducer 7 index definition
+#define TRANSDUCER_7      0x07
+//! \def TRANSDUCER_8
+//! \brief Transducer 8 index definition
+#define TRANSDUCER_8      0x08
+//! \def TRANSDUCER_9
+//! \brief Transducer 9 index definition
+#define TRANSDUCER_9      0x09
+//! \def TRANSDUCER_10
+//! \brief Transducer 10 index definition
+#define TRANSDUCER_10     0x0A
+//! \def TRANSDUCER_11
+//! \brief Transducer 11 index definition
+#define TRANSDUCER_11     0x0B
+//! \def TRANSDUCER_12
+//! \brief Transducer 12 index definition
+#define TRANSDUCER_12     0x0C
+//! \def TRANSDUCER_13
+//! \brief Transducer 13 index definition
+#define TRANSDUCER_13     0x0D
 
 //! @name SP Board configuration data
 //!
@@ -66,7 +99,7 @@ signed int g_iVLOCal;
 //! @{
 //! \def NUM_TRANSDUCERS
 //! \brief The number of transducers the SP board can have attached
-#define NUM_TRANSDUCERS	4
+#define NUM_TRANSDUCERS	13
 //! \def TYPE_IS_SENSOR
 //! \brief The transducer type definition for a sensor
 #define TYPE_IS_SENSOR			0x53 //ascii S
@@ -75,14 +108,257 @@ signed int g_iVLOCal;
 #define TYPE_IS_ACTUATOR	0x41 //ascii A
 //! @}
 
+//! @name Event trigger flags
+//! Bits of g_ucEventTrigger, set from interrupts and handled in vMain_EventTrigger()
+//! @{
+//! \def EVENT_LIGHT_SAMPLE
+//! \brief The background sampling period has elapsed
+#define EVENT_LIGHT_SAMPLE	0x01
+//! \def EVENT_LIGHT_RELEASE
+//! \brief The warm-hold time after the last COMMAND_PKT has elapsed
+#define EVENT_LIGHT_RELEASE	0x02
+//! @}
+
+//! @name Light transducer parameters
+//! The CP may append these parameter bytes to any light transducer in a
+//! COMMAND_PKT. Bytes that are not sent take their default value.
+//! @{
+//! \def LIGHT_PARAM_OVERSAMPLE
+//! \brief Oversampling exponent n, 4^n samples are decimated to 12+n bits (default 0, plain average)
+#define LIGHT_PARAM_OVERSAMPLE	0
+//! \def LIGHT_PARAM_FILTER
+//! \brief Estimator of the single channel reads, 0 mean, 1 median, 2 trimmed mean (default 0)
+#define LIGHT_PARAM_FILTER		1
+//! \def LIGHT_PARAM_COMP
+//! \brief Reference/supply compensation, 0 off, 1 reference offset and gain, 2 supply ratiometric (default 0)
+#define LIGHT_PARAM_COMP		2
+//! \def LIGHT_PARAM_RATE
+//! \brief Timer triggered sample rate in Hz, 2 bytes big endian, 0 software started (default 0)
+#define LIGHT_PARAM_RATE		3
+//! \def LIGHT_PARAM_DARK
+//! \brief Dark offset subtraction, 0 off, 1 on (default 0)
+#define LIGHT_PARAM_DARK		5
+//! \def LIGHT_PARAM_NOISE
+//! \brief Adaptive averaging noise target in Q4 counts, 0 keeps the fixed count (default 0)
+#define LIGHT_PARAM_NOISE		6
+//! \def LIGHT_PARAM_ADAPT_MIN
+//! \brief Fewest 16 sample blocks of an adaptive read (default 1)
+#define LIGHT_PARAM_ADAPT_MIN	7
+//! \def LIGHT_PARAM_ADAPT_MAX
+//! \brief Most 16 sample blocks of an adaptive read (default 16)
+#define LIGHT_PARAM_ADAPT_MAX	8
+//! \def LIGHT_PARAM_LEN
+//! \brief Number of light transducer parameter bytes
+#define LIGHT_PARAM_LEN			9
+//! @}
+
+//! @name Background sampling
+//! Timer A runs from ACLK (VLO/4) so the board can sleep in LPM3 between
+//! samples. Each period all four channels are swept and the averages are
+//! pushed into a small ring buffer. While background sampling is running
+//! the light transducers answer from the freshest entry instead of
+//! sampling on the command. The sweeps use their own light parameters,
+//! set by transducer 6, so they do not depend on the last command.
+//! @{
+//! \def VLO_NOMINAL_HZ
+//! \brief Typical VLO frequency, corrected by g_iVLOCal
+#define VLO_NOMINAL_HZ		12000
+//! \def ACLK_VLO_DIV_SHIFT
+//! \brief ACLK is VLO/4 outside of the VLO calibration
+#define ACLK_VLO_DIV_SHIFT	2
+//! \def LIGHT_RING_LEN
+//! \brief Number of sweeps kept in the ring buffer (power of 2)
+#define LIGHT_RING_LEN		4
+//! \def BG_PARAM_PERIOD
+//! \brief Transducer 6 parameter index of the period in seconds (2 bytes, big endian, 0 stops)
+#define BG_PARAM_PERIOD		0
+//! \def BG_PARAM_OVERSAMPLE
+//! \brief Transducer 6 parameter index of the oversampling exponent used in the background
+#define BG_PARAM_OVERSAMPLE	2
+//! \def BG_PARAM_WARM_HOLD
+//! \brief Transducer 6 parameter index of the warm-hold time in seconds
+#define BG_PARAM_WARM_HOLD	3
+//! \def BG_PARAM_LIGHT
+//! \brief Transducer 6 parameter index of the first light option of the sweeps, the
+//! bytes from here on are the light transducer parameters from LIGHT_PARAM_FILTER on
+#define BG_PARAM_LIGHT		4
+//! \def WARM_HOLD_SECONDS
+//! \brief Default time the light front end stays up after a COMMAND_PKT
+#define WARM_HOLD_SECONDS	2
+
+//! \var g_uiBgPeriod
+//! \brief Background sampling period in seconds, 0 when background sampling is off
+uint16 g_uiBgPeriod;
+//! \var g_uiBgSecondsLeft
+//! \brief Seconds until the next background sample
+volatile uint16 g_uiBgSecondsLeft;
+//! \var g_uiWarmHold
+//! \brief Seconds the light front end stays up after a COMMAND_PKT, 0 powers down at once
+uint16 g_uiWarmHold = WARM_HOLD_SECONDS;
+//! \var g_uiWarmSecondsLeft
+//! \brief Seconds until the held front end is released, 0 when no release is pending
+volatile uint16 g_uiWarmSecondsLeft;
+//! \var g_ucaBgLightParams
+//! \brief Light transducer parameters of the background sweeps
+uint8 g_ucaBgLightParams[LIGHT_PARAM_LEN];
+//! \var g_ucBgLightParamLen
+//! \brief Number of valid bytes in g_ucaBgLightParams
+uint8 g_ucBgLightParamLen;
+//! \var g_uiaLightRing
+//! \brief Ring buffer of background sweeps, one row of channel averages per entry
+uint16 g_uiaLightRing[LIGHT_RING_LEN][LIGHT_NUM_CHANNELS];
+//! \var g_ucaLightRingRes
+//! \brief Effective resolution of each ring buffer entry
+uint8 g_ucaLightRingRes[LIGHT_RING_LEN];
+//! \var g_ucLightRingHead
+//! \brief Index of the next ring buffer entry to write
+uint8 g_ucLightRingHead;
+//! \var g_ucLightRingCount
+//! \brief Number of valid entries in the ring buffer
+uint8 g_ucLightRingCount;
+//! @}
+
+//! @name Light statistics
+//! Running statistics of every light reading taken since the last
+//! REQUEST_DATA. Each reading only adds its deviation from the first
+//! reading of the window and the square of it to two 32-bit sums, so the
+//! sampling path needs no division. The mean and variance are derived from
+//! the sums when the record is built.
+//! @{
+//! \def STATS_CHANNEL_LEN
+//! \brief Bytes per channel in the statistics record (count, min, max, mean, variance)
+#define STATS_CHANNEL_LEN	12
+//! \def STATS_RECORD_LEN
+//! \brief Bytes in the statistics record, the channels followed by the resolution
+#define STATS_RECORD_LEN	(STATS_CHANNEL_LEN * LIGHT_NUM_CHANNELS + 1)
+//! \def STATS_MAX_COUNT
+//! \brief Largest window, the sum of deviations of 16 bit readings stays within an int32
+#define STATS_MAX_COUNT		0x7FFF
+
+//! \struct S_LightStats
+//! \brief Running statistics of one light channel
+struct
+{
+	uint16 m_uiCount; //!< Number of readings in the window
+	uint16 m_uiMin; //!< Smallest reading
+	uint16 m_uiMax; //!< Largest reading
+	uint16 m_uiShift; //!< First reading, the deviations are taken from it
+	int32 m_lSum; //!< Sum of the deviations
+	uint32 m_ulSumSq; //!< Sum of the squared deviations, saturating
+} S_LightStats[LIGHT_NUM_CHANNELS];
+
+//! \var g_ucaStatsRecord
+//! \brief Statistics record of transducer 7, too long for the S_Report structure
+uint8 g_ucaStatsRecord[STATS_RECORD_LEN];
+
+//! \var g_ucStatsResolution
+//! \brief Resolution of the readings in the statistics window
+uint8 g_ucStatsResolution;
+//! @}
+
+//! @name Light dose
+//! Integral of the background readings over time, in counts x seconds,
+//! kept per channel between two REQUEST_DATA messages.
+//! @{
+//! \def DOSE_RECORD_LEN
+//! \brief Bytes in the dose record, the seconds and the channels (4 bytes each) followed by the resolution
+#define DOSE_RECORD_LEN		((LIGHT_NUM_CHANNELS + 1) * 4 + 1)
+//! \var g_ucDoseActive
+//! \brief Set while the background samples are integrated into the dose
+uint8 g_ucDoseActive;
+//! \var g_ulDoseSeconds
+//! \brief Seconds integrated since the dose was last reported
+uint32 g_ulDoseSeconds;
+//! \var g_ulaDose
+//! \brief Light dose of each channel since it was last reported
+uint32 g_ulaDose[LIGHT_NUM_CHANNELS];
+//! @}
+
+//! @name Light thresholds
+//! Every background sweep is compared against a low and a high level per
+//! channel. A channel enters the high (low) state when it rises above
+//! (falls below) its level and only returns to normal once it is back by
+//! more than the hysteresis, so noise around a level raises one event.
+//! @{
+//! \def THRESH_NORMAL
+//! \brief Channel is between its levels
+#define THRESH_NORMAL		0x00
+//! \def THRESH_HIGH
+//! \brief Channel is above its high level
+#define THRESH_HIGH			0x01
+//! \def THRESH_LOW
+//! \brief Channel is below its low level
+#define THRESH_LOW			0x02
+//! \def THRESH_PARAM_CHANNEL
+//! \brief Transducer 9 parameter index of the channel (1-4)
+#define THRESH_PARAM_CHANNEL	0
+//! \def THRESH_PARAM_LOW
+//! \brief Transducer 9 parameter index of the low level (2 bytes, big endian, 0 disables)
+#define THRESH_PARAM_LOW		1
+//! \def THRESH_PARAM_HIGH
+//! \brief Transducer 9 parameter index of the high level (2 bytes, big endian, 0xFFFF disables)
+#define THRESH_PARAM_HIGH		3
+//! \def THRESH_PARAM_HYST
+//! \brief Transducer 9 parameter index of the hysteresis (2 bytes, big endian)
+#define THRESH_PARAM_HYST		5
+//! \def THRESH_PARAM_LEN
+//! \brief Number of parameter bytes transducer 9 needs
+#define THRESH_PARAM_LEN		7
+
+//! \struct S_LightThreshold
+//! \brief Threshold configuration and state of one light channel
+struct
+{
+	uint16 m_uiLow; //!< Low level
+	uint16 m_uiHigh; //!< High level
+	uint16 m_uiHyst; //!< Hysteresis applied when returning to normal
+	uint8 m_ucState; //!< THRESH_NORMAL, THRESH_HIGH or THRESH_LOW
+} S_LightThreshold[LIGHT_NUM_CHANNELS];
+//! @}
+
+//! @name Burst capture
+//! Transducer 11 records raw samples of one channel at a fixed rate and
+//! streams them to the CP, one chunk per REPORT_DATA. Each chunk starts
+//! with its sequence number and the number of chunks, followed by up to
+//! CAPTURE_CHUNK_LEN packed bytes (see light.h). MORE_DATA_BIT stays set in
+//! the replies until the last chunk is out.
+//! @{
+//! \def CAPTURE_PARAM_CHANNEL
+//! \brief Transducer 11 parameter index of the channel, 1-4 (default 1)
+#define CAPTURE_PARAM_CHANNEL	0
+//! \def CAPTURE_PARAM_SAMPLES
+//! \brief Transducer 11 parameter index of the sample count, 2 bytes big endian (default LIGHT_CAPTURE_LEN)
+#define CAPTURE_PARAM_SAMPLES	1
+//! \def CAPTURE_PARAM_RATE
+//! \brief Transducer 11 parameter index of the sample rate in Hz, 2 bytes big endian, 0 back to back (default 0)
+#define CAPTURE_PARAM_RATE		3
+//! \def CAPTURE_CHUNK_LEN
+//! \brief Packed bytes per chunk, 30 samples
+#define CAPTURE_CHUNK_LEN		45
+
+//! \var g_uiCaptureBytes
+//! \brief Packed bytes of the capture being streamed
+uint16 g_uiCaptureBytes;
+//! \var g_uiCaptureSent
+//! \brief Packed bytes already handed to the S_Report structure
+uint16 g_uiCaptureSent;
+//! \var g_ucCaptureSeq
+//! \brief Sequence number of the next chunk
+uint8 g_ucCaptureSeq;
+//! \var g_ucaCaptureChunk
+//! \brief Chunk record of transducer 11, too long for the S_Report structure
+uint8 g_ucaCaptureChunk[CAPTURE_CHUNK_LEN + 2];
+//! @}
+
 //! @name SP Board data structure
 //! @{
 //! \def NUMDATGEN
-//! \brief The number of data generating elements on this board 2 per sensor 1 for the valve plus one for the diagnostics
-#define NUMDATGEN		0x06
+//! \brief The number of data generating elements on this board, one per transducer including the test function
+#define NUMDATGEN		0x0E
 //! \def MAXDATALEN
-//! \brief This is the maximum length of a sensor reading for this board in bytes
-#define MAXDATALEN	0x02
+//! \brief This is the maximum length of a sensor reading for this board in bytes (dose record),
+//! longer records have their own buffer (see pucMain_ReportData())
+#define MAXDATALEN	DOSE_RECORD_LEN
 //! \def F_NEWDATA
 //! \brief Flag indicating that new data is loaded into the S_Report structure
 #define F_NEWDATA		0x01
@@ -96,48 +372,853 @@ struct
 } S_Report[NUMDATGEN];
 //! @}
 
+//! @name RAM budget
+//! The MSP430F235 has 2 KB of RAM. The large buffers of all modules are
+//! checked at compile time against what is left after the stack and the
+//! small globals. The deepest stack is vCORE_Run() with its message and
+//! parameter buffers (about 100 bytes) sending a confirmation with another
+//! 64 byte message, or running a light read about 10 calls deep, plus the
+//! frame of an ISR. The small globals of all modules come to about 450
+//! bytes. Check the .bss and .stack totals in the link map after adding
+//! to either.
+//! @{
+//! \def RAM_SIZE
+//! \brief Bytes of RAM (0x0200-0x09FF)
+#define RAM_SIZE			0x0800
+//! \def RAM_STACK_RESERVE
+//! \brief Bytes kept for the worst case stack
+#define RAM_STACK_RESERVE	384
+//! \def RAM_SMALL_RESERVE
+//! \brief Bytes kept for the scalars, tables and small arrays of all modules
+#define RAM_SMALL_RESERVE	480
+
+//! \brief Fails to compile (negative array size) once the large buffers overrun the budget
+typedef char RAM_BUDGET_CHECK[(sizeof(S_Report) + sizeof(g_ucaStatsRecord) + sizeof(g_ucaCaptureChunk)
+                               + sizeof(g_uiaLightRing) + LIGHT_CAPTURE_BYTES + MAXMSGLEN
+                               + RAM_STACK_RESERVE + RAM_SMALL_RESERVE <= RAM_SIZE) ? 1 : -1];
+//! @}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//! \fn vMain_CalibrateVLO
+//! \brief Generates a calibration constant for the VLO
+//!
+//! The SP-CM-STM board uses the VLO to time the duration the valve is on while
+//! allowing the board to remain in LPM3
+//!
+//! The VLO frequency should be 12 kHz, but it can range from 4 kHZ to 20 kHz.
+//! Therefore, we must determine a calibration constant before it can be used.
+//! Two timers, timer A sourced from the SMCLK and timer B from the VLO (through ACLK)
+//! run for 8.333 mS.  TBR should equal 100 ticks assuming the frequency of
+//! the VLO is 12 kHz.  The deviation from 100 is measured and scaled up to the deviation
+//! in ticks the VLO is from a full second of 12000 ticks.
+//!
+///////////////////////////////////////////////////////////////////////////////
+void vMain_CalibrateVLO(void){
+
+	// Set ACLK divider to 1
+	BCSCTL1 &= ~DIVA_3;
+
+	// Determine VLO calibration constant to improve accuracy
+	TACTL = (TASSEL_2 | TACLR | ID_2);
+	TACCTL0 &= ~CCIFG;
+	TACCR0 = 8333;
+	TBCTL = (TBSSEL_1 | TBCLR );
+	TACTL |= MC_1;
+	TBCTL |= MC_2;
+	while((TACCTL0 & CCIFG) == 0);
+
+	// Set the global cal constant
+	g_iVLOCal = (signed int)(TBR - 100)*120;
+
+	TACTL = TACLR;
+	TBCTL = TBCLR;
+	TACCR0 = 0;
+
+	// Set ACLK divider back to 4
+	BCSCTL1 |= DIVA_2;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Applies the light transducer parameter bytes sent by the CP
+//!
+//! Every light transducer call starts from the defaults so options do not
+//! leak from one command into the next.
+//!
+//! \param ucParamLen, number of parameter bytes; *pucParam, the parameters
+///////////////////////////////////////////////////////////////////////////////
+void vMain_ApplyLightParams(uint8 ucParamLen, uint8 * pucParam)
+{
+	uint8 ucOversample;
+	uint8 ucFilter;
+	uint8 ucComp;
+	uint8 ucDark;
+	uint8 ucNoise;
+	uint16 uiMin;
+	uint16 uiMax;
+	uint16 uiRate;
+
+	ucOversample = 0;
+	if (ucParamLen > LIGHT_PARAM_OVERSAMPLE)
+		ucOversample = pucParam[LIGHT_PARAM_OVERSAMPLE];
+
+	ucFilter = LIGHT_FILTER_MEAN;
+	if (ucParamLen > LIGHT_PARAM_FILTER)
+		ucFilter = pucParam[LIGHT_PARAM_FILTER];
+
+	ucComp = LIGHT_COMP_OFF;
+	if (ucParamLen > LIGHT_PARAM_COMP)
+		ucComp = pucParam[LIGHT_PARAM_COMP];
+
+	uiRate = 0;
+	if (ucParamLen > LIGHT_PARAM_RATE + 1)
+		uiRate = ((uint16) pucParam[LIGHT_PARAM_RATE] << 8) | pucParam[LIGHT_PARAM_RATE + 1];
+
+	ucDark = 0;
+	if (ucParamLen > LIGHT_PARAM_DARK)
+		ucDark = pucParam[LIGHT_PARAM_DARK];
+
+	ucNoise = 0;
+	if (ucParamLen > LIGHT_PARAM_NOISE)
+		ucNoise = pucParam[LIGHT_PARAM_NOISE];
+
+	uiMin = LIGHT_ADAPT_MIN_AVG;
+	if (ucParamLen > LIGHT_PARAM_ADAPT_MIN)
+		uiMin = (uint16) pucParam[LIGHT_PARAM_ADAPT_MIN] << 4;
+
+	uiMax = LIGHT_ADAPT_MAX_AVG;
+	if (ucParamLen > LIGHT_PARAM_ADAPT_MAX)
+		uiMax = (uint16) pucParam[LIGHT_PARAM_ADAPT_MAX] << 4;
+
+	vLIGHT_SetOversampling(ucOversample);
+	vLIGHT_SetFilter(ucFilter);
+	vLIGHT_SetCompensation(ucComp);
+	vLIGHT_SetSampleRate(uiRate);
+	vLIGHT_SetDarkCorrection(ucDark);
+	vLIGHT_SetAdaptive(ucNoise, uiMin, uiMax);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Stores light readings in a data generator of the S_Report structure
+//!
+//! Readings are stored big endian. When oversampling is active a trailing
+//! byte holds the effective resolution in bits so the CP can scale them.
+//! After an adaptive read two more bytes hold the number of samples
+//! averaged, big endian.
+//!
+//! \param ucDataGen, the data generator; *puiValues, the readings;
+//! ucCount, number of readings; ucResolution, effective bits of the readings
+///////////////////////////////////////////////////////////////////////////////
+void vMain_ReportLight(uint8 ucDataGen, uint16 * puiValues, uint8 ucCount, uint8 ucResolution)
+{
+	uint8 ucIdx;
+	uint8 ucByteCnt;
+	uint16 uiCount;
+
+	ucByteCnt = 0;
+	for (ucIdx = 0; ucIdx < ucCount; ucIdx++) {
+		S_Report[ucDataGen].m_ucaData[ucByteCnt++] = (uint8)(puiValues[ucIdx] >> 8);
+		S_Report[ucDataGen].m_ucaData[ucByteCnt++] = (uint8) puiValues[ucIdx];
+	}
+
+	if (ucResolution != LIGHT_ADC_BITS)
+		S_Report[ucDataGen].m_ucaData[ucByteCnt++] = ucResolution;
+
+	uiCount = unLIGHT_GetAdaptiveCount();
+	if (uiCount) {
+		S_Report[ucDataGen].m_ucaData[ucByteCnt++] = (uint8)(uiCount >> 8);
+		S_Report[ucDataGen].m_ucaData[ucByteCnt++] = (uint8) uiCount;
+	}
+
+	S_Report[ucDataGen].m_ucLength = ucByteCnt;
+	S_Report[ucDataGen].m_ucFlags |= F_NEWDATA;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Returns where the record of a data generator is stored
+//!
+//! Records longer than MAXDATALEN have their own buffer, the S_Report
+//! entry of their generator only holds the length and the flags.
+//!
+//! \param ucDataGen, the data generator
+//! \return pointer to the record bytes
+///////////////////////////////////////////////////////////////////////////////
+uint8 * pucMain_ReportData(uint8 ucDataGen)
+{
+	if (ucDataGen == TRANSDUCER_7)
+		return g_ucaStatsRecord;
+	if (ucDataGen == TRANSDUCER_11)
+		return g_ucaCaptureChunk;
+
+	return S_Report[ucDataGen].m_ucaData;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Empties the light statistics window
+///////////////////////////////////////////////////////////////////////////////
+void vMain_StatsReset(void)
+{
+	uint8 ucChannel;
+
+	for (ucChannel = 0; ucChannel < LIGHT_NUM_CHANNELS; ucChannel++)
+		S_LightStats[ucChannel].m_uiCount = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Adds a light reading to the running statistics of its channel
+//!
+//! Taking the deviations from the first reading keeps the sums small for
+//! steady light, so the variance does not come from a difference of large
+//! sums. Readings of a different resolution than the ones already in the
+//! window start a new window, they cannot be mixed.
+//!
+//! \param ucChannel, channel index (0-3); uiValue, the reading;
+//! ucResolution, effective bits of the reading
+///////////////////////////////////////////////////////////////////////////////
+void vMain_StatsAdd(uint8 ucChannel, uint16 uiValue, uint8 ucResolution)
+{
+	uint16 uiDiff;
+
+	if (ucResolution != g_ucStatsResolution) {
+		vMain_StatsReset();
+		g_ucStatsResolution = ucResolution;
+	}
+
+	// The window is full, keep the statistics as they are
+	if (S_LightStats[ucChannel].m_uiCount == STATS_MAX_COUNT)
+		return;
+
+	S_LightStats[ucChannel].m_uiCount++;
+
+	if (S_LightStats[ucChannel].m_uiCount == 1) {
+		S_LightStats[ucChannel].m_uiMin = uiValue;
+		S_LightStats[ucChannel].m_uiMax = uiValue;
+		S_LightStats[ucChannel].m_uiShift = uiValue;
+		S_LightStats[ucChannel].m_lSum = 0;
+		S_LightStats[ucChannel].m_ulSumSq = 0;
+		return;
+	}
+
+	if (uiValue < S_LightStats[ucChannel].m_uiMin)
+		S_LightStats[ucChannel].m_uiMin = uiValue;
+	if (uiValue > S_LightStats[ucChannel].m_uiMax)
+		S_LightStats[ucChannel].m_uiMax = uiValue;
+
+	if (uiValue >= S_LightStats[ucChannel].m_uiShift) {
+		uiDiff = uiValue - S_LightStats[ucChannel].m_uiShift;
+		S_LightStats[ucChannel].m_lSum += uiDiff;
+	}
+	else {
+		uiDiff = S_LightStats[ucChannel].m_uiShift - uiValue;
+		S_LightStats[ucChannel].m_lSum -= uiDiff;
+	}
+	S_LightStats[ucChannel].m_ulSumSq = ulFIXMATH_MacSat(S_LightStats[ucChannel].m_ulSumSq, uiDiff, uiDiff);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Derives the mean and the sample variance of a channel from its sums
+//!
+//! With S1 and S2 the sums of the deviations from the first reading K and
+//! of their squares, the mean is K + S1/n and the sum of squared deviations
+//! from the mean is S2 - S1^2/n. Splitting |S1| = q n + r gives
+//! S1^2/n = q |S1| + q r + r^2/n, which never leaves 32 bits since
+//! S1^2/n <= S2. The divisions are paid once per record, not per reading.
+//!
+//! \param ucChannel, channel index (0-3) with at least one reading;
+//! *puiMean, receives the rounded mean
+//! \return the sample variance in 1/256 counts^2, saturating
+///////////////////////////////////////////////////////////////////////////////
+uint32 ulMain_StatsVariance(uint8 ucChannel, uint16 * puiMean)
+{
+	uint32 ulAbsSum;
+	uint32 ulQuot;
+	uint32 ulRem;
+	uint32 ulM2;
+	uint16 uiCount;
+	uint16 uiOffset;
+
+	uiCount = S_LightStats[ucChannel].m_uiCount;
+
+	ulAbsSum = (uint32) S_LightStats[ucChannel].m_lSum;
+	if (S_LightStats[ucChannel].m_lSum < 0)
+		ulAbsSum = -ulAbsSum;
+	ulQuot = ulAbsSum / uiCount;
+	ulRem = ulAbsSum - ulQuot * uiCount;
+
+	// The mean lies between min and max, the rounded offset cannot wrap
+	uiOffset = (uint16) ulQuot + ((ulRem << 1) >= uiCount);
+	if (S_LightStats[ucChannel].m_lSum < 0)
+		*puiMean = S_LightStats[ucChannel].m_uiShift - uiOffset;
+	else
+		*puiMean = S_LightStats[ucChannel].m_uiShift + uiOffset;
+
+	if (uiCount < 2)
+		return 0;
+	if (S_LightStats[ucChannel].m_ulSumSq == 0xFFFFFFFF)
+		return 0xFFFFFFFF;
+
+	ulM2 = ulQuot * ulAbsSum + ulQuot * ulRem + (ulRem * ulRem + (uiCount >> 1)) / uiCount;
+	ulM2 = (S_LightStats[ucChannel].m_ulSumSq > ulM2) ? S_LightStats[ucChannel].m_ulSumSq - ulM2 : 0;
+
+	// M2 / (n - 1) in Q8 without shifting M2 out of 32 bits
+	uiCount--;
+	ulQuot = ulM2 / uiCount;
+	if (ulQuot > 0x00FFFFFF)
+		return 0xFFFFFFFF;
+	ulRem = ulM2 - ulQuot * uiCount;
+
+	return (ulQuot << 8) + (ulRem << 8) / uiCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Stores the statistics window in the record of a data generator
+//!
+//! Each channel holds its reading count, min, max and rounded mean (2 bytes
+//! each) and the sample variance in 1/256 counts^2 (4 bytes, saturating),
+//! all big endian. The resolution of the readings follows the channels.
+//! The variance also saturates once the sum of squares has.
+//!
+//! \param ucDataGen, the data generator
+///////////////////////////////////////////////////////////////////////////////
+void vMain_ReportStats(uint8 ucDataGen)
+{
+	uint8 * pucData;
+	uint8 ucChannel;
+	uint8 ucByteCnt;
+	uint16 uiCount;
+	uint16 uiMean;
+	uint32 ulVar;
+
+	pucData = pucMain_ReportData(ucDataGen);
+
+	ucByteCnt = 0;
+	for (ucChannel = 0; ucChannel < LIGHT_NUM_CHANNELS; ucChannel++) {
+		uiCount = S_LightStats[ucChannel].m_uiCount;
+		uiMean = 0;
+		ulVar = 0;
+
+		if (uiCount == 0) {
+			S_LightStats[ucChannel].m_uiMin = 0;
+			S_LightStats[ucChannel].m_uiMax = 0;
+		}
+		else {
+			ulVar = ulMain_StatsVariance(ucChannel, &uiMean);
+		}
+
+		pucData[ucByteCnt++] = (uint8) (uiCount >> 8);
+		pucData[ucByteCnt++] = (uint8) uiCount;
+		pucData[ucByteCnt++] = (uint8) (S_LightStats[ucChannel].m_uiMin >> 8);
+		pucData[ucByteCnt++] = (uint8) S_LightStats[ucChannel].m_uiMin;
+		pucData[ucByteCnt++] = (uint8) (S_LightStats[ucChannel].m_uiMax >> 8);
+		pucData[ucByteCnt++] = (uint8) S_LightStats[ucChannel].m_uiMax;
+		pucData[ucByteCnt++] = (uint8) (uiMean >> 8);
+		pucData[ucByteCnt++] = (uint8) uiMean;
+		pucData[ucByteCnt++] = (uint8) (ulVar >> 24);
+		pucData[ucByteCnt++] = (uint8) (ulVar >> 16);
+		pucData[ucByteCnt++] = (uint8) (ulVar >> 8);
+		pucData[ucByteCnt++] = (uint8) ulVar;
+	}
+
+	pucData[ucByteCnt++] = g_ucStatsResolution;
+
+	S_Report[ucDataGen].m_ucLength = ucByteCnt;
+	S_Report[ucDataGen].m_ucFlags |= F_NEWDATA;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Clears the dose integrals
+///////////////////////////////////////////////////////////////////////////////
+void vMain_DoseReset(void)
+{
+	uint8 ucChannel;
+
+	g_ulDoseSeconds = 0;
+	for (ucChannel = 0; ucChannel < LIGHT_NUM_CHANNELS; ucChannel++)
+		g_ulaDose[ucChannel] = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Integrates a background sweep into the dose
+//!
+//! Each reading is held for the whole sampling period, which is timed by
+//! the VLO calibrated Timer A. The integrals saturate instead of wrapping.
+//!
+//! \param *puiValues, the readings of all channels; uiSeconds, the period
+///////////////////////////////////////////////////////////////////////////////
+void vMain_DoseAdd(uint16 * puiValues, uint16 uiSeconds)
+{
+	uint8 ucChannel;
+
+	g_ulDoseSeconds += uiSeconds;
+
+	for (ucChannel = 0; ucChannel < LIGHT_NUM_CHANNELS; ucChannel++)
+		g_ulaDose[ucChannel] = ulFIXMATH_MacSat(g_ulaDose[ucChannel], puiValues[ucChannel], uiSeconds);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Stores the dose in a data generator and starts a new integral
+//!
+//! The record holds the integration time in seconds followed by the
+//! integral of each channel, all 4 bytes big endian, and the resolution of
+//! the integrated readings. A record the CP has not fetched yet is left in
+//! place and the integral keeps running, so no dose is lost.
+//!
+//! \param ucDataGen, the data generator
+///////////////////////////////////////////////////////////////////////////////
+void vMain_ReportDose(uint8 ucDataGen)
+{
+	uint8 ucChannel;
+	uint8 ucByteCnt;
+	uint32 ulValue;
+
+	if (S_Report[ucDataGen].m_ucFlags & F_NEWDATA)
+		return;
+
+	ucByteCnt = 0;
+	for (ucChannel = 0; ucChannel <= LIGHT_NUM_CHANNELS; ucChannel++) {
+		ulValue = (ucChannel == 0) ? g_ulDoseSeconds : g_ulaDose[ucChannel - 1];
+
+		S_Report[ucDataGen].m_ucaData[ucByteCnt++] = (uint8) (ulValue >> 24);
+		S_Report[ucDataGen].m_ucaData[ucByteCnt++] = (uint8) (ulValue >> 16);
+		S_Report[ucDataGen].m_ucaData[ucByteCnt++] = (uint8) (ulValue >> 8);
+		S_Report[ucDataGen].m_ucaData[ucByteCnt++] = (uint8) ulValue;
+	}
+
+	S_Report[ucDataGen].m_ucaData[ucByteCnt++] = LIGHT_ADC_BITS + g_ucaBgLightParams[LIGHT_PARAM_OVERSAMPLE];
+
+	S_Report[ucDataGen].m_ucLength = ucByteCnt;
+	S_Report[ucDataGen].m_ucFlags |= F_NEWDATA;
+
+	vMain_DoseReset();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Disables the thresholds of all channels
+///////////////////////////////////////////////////////////////////////////////
+void vMain_ThresholdInit(void)
+{
+	uint8 ucChannel;
+
+	for (ucChannel = 0; ucChannel < LIGHT_NUM_CHANNELS; ucChannel++) {
+		S_LightThreshold[ucChannel].m_uiLow = 0;
+		S_LightThreshold[ucChannel].m_uiHigh = 0xFFFF;
+		S_LightThreshold[ucChannel].m_uiHyst = 0;
+		S_LightThreshold[ucChannel].m_ucState = THRESH_NORMAL;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Tells the CP that there is data to fetch
+//!
+//! The interrupt line is an input with an edge interrupt while idle. It is
+//! turned into an output and driven high until the CP fetches the data.
+///////////////////////////////////////////////////////////////////////////////
+void vMain_RaiseInterrupt(void)
+{
+	P_INT_IE &= ~INT_PIN;
+	P_INT_OUT |= INT_PIN;
+	P_INT_DIR |= INT_PIN;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Releases the interrupt line back to its idle input state
+///////////////////////////////////////////////////////////////////////////////
+void vMain_ReleaseInterrupt(void)
+{
+	P_INT_OUT &= ~INT_PIN;
+	P_INT_DIR &= ~INT_PIN;
+	P_INT_IFG &= ~INT_PIN;
+	P_INT_IE |= INT_PIN;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Compares a background sweep against the channel thresholds
+//!
+//! When any channel changes state the sweep is queued in data generator 9
+//! and the interrupt line is raised. The record holds a mask of the
+//! channels that changed, the state of every channel (2 bits each, channel
+//! 1 in the low bits), the four readings big endian and their resolution.
+//! Changes that happen before the CP fetches the record are merged into it.
+//!
+//! \param *puiValues, the readings of all channels; ucResolution, their
+//! effective bits
+///////////////////////////////////////////////////////////////////////////////
+void vMain_ThresholdCheck(uint16 * puiValues, uint8 ucResolution)
+{
+	uint8 ucChannel;
+	uint8 ucState;
+	uint8 ucChanged;
+	uint8 ucStates;
+	uint8 ucByteCnt;
+	uint16 uiValue;
+
+	ucChanged = 0;
+	ucStates = 0;
+
+	for (ucChannel = 0; ucChannel < LIGHT_NUM_CHANNELS; ucChannel++) {
+		uiValue = puiValues[ucChannel];
+		ucState = S_LightThreshold[ucChannel].m_ucState;
+
+		switch (ucState)
+		{
+			case THRESH_HIGH:
+				if ((uint32) uiValue + S_LightThreshold[ucChannel].m_uiHyst < S_LightThreshold[ucChannel].m_uiHigh)
+					ucState = THRESH_NORMAL;
+			break;
+
+			case THRESH_LOW:
+				if (uiValue > (uint32) S_LightThreshold[ucChannel].m_uiLow + S_LightThreshold[ucChannel].m_uiHyst)
+					ucState = THRESH_NORMAL;
+			break;
+
+			default:
+				if (uiValue > S_LightThreshold[ucChannel].m_uiHigh)
+					ucState = THRESH_HIGH;
+				else if (uiValue < S_LightThreshold[ucChannel].m_uiLow)
+					ucState = THRESH_LOW;
+			break;
+		}
+
+		if (ucState != S_LightThreshold[ucChannel].m_ucState) {
+			S_LightThreshold[ucChannel].m_ucState = ucState;
+			ucChanged |= 1 << ucChannel;
+		}
+
+		ucStates |= ucState << (ucChannel << 1);
+	}
+
+	if (ucChanged == 0)
+		return;
+
+	// Keep the channels of a record the CP has not fetched yet
+	if (S_Report[TRANSDUCER_9].m_ucFlags & F_NEWDATA)
+		ucChanged |= S_Report[TRANSDUCER_9].m_ucaData[0];
+
+	ucByteCnt = 0;
+	S_Report[TRANSDUCER_9].m_ucaData[ucByteCnt++] = ucChanged;
+	S_Report[TRANSDUCER_9].m_ucaData[ucByteCnt++] = ucStates;
+	for (ucChannel = 0; ucChannel < LIGHT_NUM_CHANNELS; ucChannel++) {
+		S_Report[TRANSDUCER_9].m_ucaData[ucByteCnt++] = (uint8) (puiValues[ucChannel] >> 8);
+		S_Report[TRANSDUCER_9].m_ucaData[ucByteCnt++] = (uint8) puiValues[ucChannel];
+	}
+	S_Report[TRANSDUCER_9].m_ucaData[ucByteCnt++] = ucResolution;
+
+	S_Report[TRANSDUCER_9].m_ucLength = ucByteCnt;
+	S_Report[TRANSDUCER_9].m_ucFlags |= F_NEWDATA;
+
+	vMain_RaiseInterrupt();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Converts the readings of a four channel sweep to engineering units
+//!
+//! \param *puiValues, the readings of all channels; ucResolution, their
+//! effective bits
+///////////////////////////////////////////////////////////////////////////////
+void vMain_CalibrateSweep(uint16 * puiValues, uint8 ucResolution)
+{
+	uint8 ucChannel;
+
+	for (ucChannel = 0; ucChannel < LIGHT_NUM_CHANNELS; ucChannel++)
+		puiValues[ucChannel] = unLIGHT_Calibrate(ucChannel, puiValues[ucChannel], ucResolution);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Loads the calibration table from flash into the light module
+//!
+//! An erased or invalid table leaves calibration off and the light
+//! transducers report raw counts.
+///////////////////////////////////////////////////////////////////////////////
+void vMain_LoadCalibration(void)
+{
+	uint8 ucaTable[LIGHT_CAL_LEN];
+
+	vFlash_GetCal(ucaTable, LIGHT_CAL_LEN);
+	ucLIGHT_LoadCalibration(ucaTable, LIGHT_CAL_LEN);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Reads the calibration table for the core
+//!
+//! \param *pucBuff, destination of the table
+//! \return the length of the table
+///////////////////////////////////////////////////////////////////////////////
+uint8 ucMain_GetCalTable(volatile uint8 * pucBuff)
+{
+	vFlash_GetCal(pucBuff, LIGHT_CAL_LEN);
+	return LIGHT_CAL_LEN;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Checks, stores and applies a calibration table sent by the CP
+//!
+//! \param *pucBuff, the table; ucLen, its length
+//! \return 0 on success, 1 if the table is invalid or the write failed
+///////////////////////////////////////////////////////////////////////////////
+uint8 ucMain_SetCalTable(volatile uint8 * pucBuff, uint8 ucLen)
+{
+	uint8 ucErrCode;
+
+	// Reject a bad table and keep the stored one
+	if (ucLIGHT_LoadCalibration(pucBuff, ucLen)) {
+		vMain_LoadCalibration();
+		return 1;
+	}
+
+	ucErrCode = ucFlash_SetCal(pucBuff, ucLen);
+
+	// Apply what actually ended up in flash
+	vMain_LoadCalibration();
+
+	return ucErrCode;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Reports the freshest background sweep for a light transducer
+//!
+//! The sweeps are taken with the background parameters, so a command that
+//! carries its own filter, compensation or other options is sampled on
+//! command instead.
+//!
+//! \param ucTransNum, the light transducer (1-4 single channel, 5 all);
+//! ucParamLen, number of parameter bytes of the command
+//! \return 1 if the report was made from the ring buffer, 0 if the caller
+//! has to sample
+///////////////////////////////////////////////////////////////////////////////
+uint8 ucMain_ReportCachedLight(uint8 ucTransNum, uint8 ucParamLen)
+{
+	uint8 ucEntry;
+
+	if (g_uiBgPeriod == 0 || g_ucLightRingCount == 0 || ucParamLen != 0)
+		return 0;
+
+	// The entry before the head is the last completed sweep
+	ucEntry = (g_ucLightRingHead - 1) & (LIGHT_RING_LEN - 1);
+
+	if (ucTransNum == TRANSDUCER_5)
+		vMain_ReportLight(ucTransNum, g_uiaLightRing[ucEntry], LIGHT_NUM_CHANNELS, g_ucaLightRingRes[ucEntry]);
+	else
+		vMain_ReportLight(ucTransNum, &g_uiaLightRing[ucEntry][ucTransNum - 1], 1, g_ucaLightRingRes[ucEntry]);
+
+	return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Sweeps all light channels into the next ring buffer entry
+//!
+//! Called from vMain_EventTrigger() when the background period elapses.
+///////////////////////////////////////////////////////////////////////////////
+void vMain_BackgroundSample(void)
+{
+	uint8 ucEntry;
+	uint8 ucChannel;
+
+	ucEntry = g_ucLightRingHead;
+
+	vMain_ApplyLightParams(g_ucBgLightParamLen, g_ucaBgLightParams);
+
+	vLight_Init();
+	vLIGHT_ReadChannels(LIGHT_ALL_CHANNELS, &g_uiAveCounter, g_uiaLightRing[ucEntry]);
+	vLight_Shutdown();
+
+	g_ucaLightRingRes[ucEntry] = ucLIGHT_GetResolution();
+	vMain_CalibrateSweep(g_uiaLightRing[ucEntry], g_ucaLightRingRes[ucEntry]);
+
+	for (ucChannel = 0; ucChannel < LIGHT_NUM_CHANNELS; ucChannel++)
+		vMain_StatsAdd(ucChannel, g_uiaLightRing[ucEntry][ucChannel], g_ucaLightRingRes[ucEntry]);
+
+	if (g_ucDoseActive)
+		vMain_DoseAdd(g_uiaLightRing[ucEntry], g_uiBgPeriod);
+
+	vMain_ThresholdCheck(g_uiaLightRing[ucEntry], g_ucaLightRingRes[ucEntry]);
+
+	// Publish the entry only once it is complete
+	g_ucLightRingHead = (ucEntry + 1) & (LIGHT_RING_LEN - 1);
+	if (g_ucLightRingCount < LIGHT_RING_LEN)
+		g_ucLightRingCount++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Restarts the one second tick
+//!
+//! Timer A counts ACLK in up mode and interrupts once a second. The VLO
+//! calibration constant corrects the number of ticks in a second.
+///////////////////////////////////////////////////////////////////////////////
+void vMain_StartSecondTick(void)
+{
+	TACTL = TACLR;
+	TACCR0 = ((VLO_NOMINAL_HZ + g_iVLOCal) >> ACLK_VLO_DIV_SHIFT) - 1;
+	TACCTL0 = CCIE;
+	TACTL = TASSEL_1 | MC_1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Stops the one second tick
+///////////////////////////////////////////////////////////////////////////////
+void vMain_StopSecondTick(void)
+{
+	TACTL = TACLR;
+	TACCTL0 = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Starts or stops the background sampling timer
+//!
+//! The first sample is taken one period after the call.
+//!
+//! \param uiPeriod, the sampling period in seconds, 0 stops sampling
+///////////////////////////////////////////////////////////////////////////////
+void vMain_SetBackgroundPeriod(uint16 uiPeriod)
+{
+	// Drop any pending sample
+	g_ucEventTrigger &= ~EVENT_LIGHT_SAMPLE;
+
+	g_uiBgPeriod = uiPeriod;
+	g_ucLightRingCount = 0;
+
+	// A new period ends the dose integration, transducer 8 restarts it
+	g_ucDoseActive = 0;
+	vMain_DoseReset();
+
+	if (uiPeriod == 0) {
+		// The tick keeps running for a pending warm-hold release
+		if (g_uiWarmSecondsLeft == 0)
+			vMain_StopSecondTick();
+		return;
+	}
+
+	// Take the first sample one period from now
+	g_uiBgSecondsLeft = uiPeriod;
+	vMain_StartSecondTick();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Called by the core before the transducers of a COMMAND_PKT run
+//!
+//! The light front end is held up for the whole packet, so vLight_Init()
+//! and the settle delays are paid by the first light transducer only. A
+//! packet arriving within the warm-hold time finds it still up.
+///////////////////////////////////////////////////////////////////////////////
+void vMain_SessionBegin(void)
+{
+	g_uiWarmSecondsLeft = 0;
+	g_ucEventTrigger &= ~EVENT_LIGHT_RELEASE;
+
+	vLIGHT_Hold(1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Called by the core after the transducers of a COMMAND_PKT ran
+//!
+//! Keeps the front end warm for g_uiWarmHold seconds in case another
+//! packet follows, the one second tick then releases it.
+///////////////////////////////////////////////////////////////////////////////
+void vMain_SessionEnd(void)
+{
+	if (g_uiWarmHold == 0 || !ucLIGHT_IsPowered()) {
+		vLIGHT_Hold(0);
+		return;
+	}
+
+	g_uiWarmSecondsLeft = g_uiWarmHold;
+	if (!(TACTL & MC_1))
+		vMain_StartSecondTick();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//!   \brief Handle for when Transducer 6 is called
+//!
+//!   Configures background sampling. The first two parameter bytes hold the
+//!   period in seconds (0 stops background sampling), the optional third
+//!   byte the oversampling exponent used for the background sweeps and the
+//!   optional fourth byte the warm-hold time in seconds. Any further bytes
+//!   set the other light options of the sweeps, in the order of the light
+//!   transducer parameters from LIGHT_PARAM_FILTER on.
+//!
+//!   \param ucParamLen, number of parameter bytes; *param, the parameters
+//!
+//!   \return 0: success
+///////////////////////////////////////////////////////////////////////////////
+uint16 uiMain_SLBackground(uint8 ucParamLen, uint8 * param)
+{
+	uint16 uiPeriod;
+	uint8 ucIdx;
+
+	uiPeriod = 0;
+	if (ucParamLen > BG_PARAM_PERIOD + 1)
+		uiPeriod = ((uint16) param[BG_PARAM_PERIOD] << 8) | param[BG_PARAM_PERIOD + 1];
+
+	g_ucaBgLightParams[LIGHT_PARAM_OVERSAMPLE] = 0;
+	if (ucParamLen > BG_PARAM_OVERSAMPLE)
+		g_ucaBgLightParams[LIGHT_PARAM_OVERSAMPLE] = param[BG_PARAM_OVERSAMPLE];
+
+	g_ucBgLightParamLen = LIGHT_PARAM_FILTER;
+	for (ucIdx = BG_PARAM_LIGHT; ucIdx < ucParamLen && g_ucBgLightParamLen < LIGHT_PARAM_LEN; ucIdx++)
+		g_ucaBgLightParams[g_ucBgLightParamLen++] = param[ucIdx];
+
+	g_uiWarmHold = WARM_HOLD_SECONDS;
+	if (ucParamLen > BG_PARAM_WARM_HOLD)
+		g_uiWarmHold = param[BG_PARAM_WARM_HOLD];
+
+	vMain_SetBackgroundPeriod(uiPeriod);
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//!   \brief Handle for when Transducer 8 is called
+//!
+//!   Starts background sampling with the same parameter bytes as transducer
+//!   6 and integrates every sweep into the light dose. The dose is reported
+//!   and restarted on every REQUEST_DATA. A period of 0 stops sampling and
+//!   integration.
+//!
+//!   \param ucParamLen, number of parameter bytes; *param, the parameters
+//!
+//!   \return 0: success
+///////////////////////////////////////////////////////////////////////////////
+uint16 uiMain_SLDose(uint8 ucParamLen, uint8 * param)
+{
+	uiMain_SLBackground(ucParamLen, param);
+
+	if (g_uiBgPeriod != 0)
+		g_ucDoseActive = 1;
+
+	return 0;
+}
 
 ///////////////////////////////////////////////////////////////////////////////
-//! \fn vMain_CalibrateVLO
-//! \brief Generates a calibration constant for the VLO
+//!   \brief Handle for when Transducer 9 is called
 //!
-//! The SP-CM-STM board uses the VLO to time the duration the valve is on while
-//! allowing the board to remain in LPM3
+//!   Sets the low and high level and the hysteresis of one channel. The
+//!   levels are compared with the background sweeps started by transducer
+//!   6 or 8, in the resolution those sweeps use. The channel starts out in
+//!   the normal state.
 //!
-//! The VLO frequency should be 12 kHz, but it can range from 4 kHZ to 20 kHz.
-//! Therefore, we must determine a calibration constant before it can be used.
-//! Two timers, timer A sourced from the SMCLK and timer B from the VLO (through ACLK)
-//! run for 8.333 mS.  TBR should equal 100 ticks assuming the frequency of
-//! the VLO is 12 kHz.  The deviation from 100 is measured and scaled up to the deviation
-//! in ticks the VLO is from a full second of 12000 ticks.
+//!   \param ucParamLen, number of parameter bytes; *param, the parameters
 //!
+//!   \return 0: success, 1: missing parameters or invalid channel
 ///////////////////////////////////////////////////////////////////////////////
-void vMain_CalibrateVLO(void){
-
-	// Set ACLK divider to 1
-	BCSCTL1 &= ~DIVA_3;
+uint16 uiMain_SLThreshold(uint8 ucParamLen, uint8 * param)
+{
+	uint8 ucChannel;
 
-	// Determine VLO calibration constant to improve accuracy
-	TACTL = (TASSEL_2 | TACLR | ID_2);
-	TACCTL0 &= ~CCIFG;
-	TACCR0 = 8333;
-	TBCTL = (TBSSEL_1 | TBCLR );
-	TACTL |= MC_1;
-	TBCTL |= MC_2;
-	while((TACCTL0 & CCIFG) == 0);
+	if (ucParamLen < THRESH_PARAM_LEN)
+		return 1;
 
-	// Set the global cal constant
-	g_iVLOCal = (signed int)(TBR - 100)*120;
+	ucChannel = param[THRESH_PARAM_CHANNEL];
+	if (ucChannel == 0 || ucChannel > LIGHT_NUM_CHANNELS)
+		return 1;
+	ucChannel--;
 
-	TACTL = TACLR;
-	TBCTL = TBCLR;
-	TACCR0 = 0;
+	S_LightThreshold[ucChannel].m_uiLow = ((uint16) param[THRESH_PARAM_LOW] << 8) | param[THRESH_PARAM_LOW + 1];
+	S_LightThreshold[ucChannel].m_uiHigh = ((uint16) param[THRESH_PARAM_HIGH] << 8) | param[THRESH_PARAM_HIGH + 1];
+	S_LightThreshold[ucChannel].m_uiHyst = ((uint16) param[THRESH_PARAM_HYST] << 8) | param[THRESH_PARAM_HYST + 1];
+	S_LightThreshold[ucChannel].m_ucState = THRESH_NORMAL;
 
-	// Set ACLK divider back to 4
-	BCSCTL1 |= DIVA_2;
+	return 0;
 }
 
-
 ///////////////////////////////////////////////////////////////////////////////
 //!   \brief Handle for when Test Function is called
 //!
@@ -167,21 +1248,24 @@ uint16 uiMain_Test(uint8 * param)
 //!
 //!   \return 1: success, 0: failure
 ///////////////////////////////////////////////////////////////////////////////
-uint16 uiMain_SL1(uint8 * param)
+uint16 uiMain_SL1(uint8 ucParamLen, uint8 * param)
 {
 
 	uint16 uiLight;
 
+	// Answer from the background samples unless the command has its own options
+	if (ucMain_ReportCachedLight(TRANSDUCER_1, ucParamLen))
+		return 0;
+
   //Initialize the light sensor hardware
   vLight_Init();
 
   //Read the sensor and store the data
-  uiLight = unLIGHT_ReadChannel_1(&g_uiAveCounter, &g_uiDummDumm);
+  uiLight = unLIGHT_ReadChannel(1, &g_uiAveCounter);
+  uiLight = unLIGHT_Calibrate(0, uiLight, ucLIGHT_GetResolution());
 
-	S_Report[1].m_ucaData[0] = (uint8)(uiLight >> 8);
-	S_Report[1].m_ucaData[1] = (uint8) uiLight;
-	S_Report[1].m_ucLength = 2;
-	S_Report[1].m_ucFlags |= F_NEWDATA;
+	vMain_ReportLight(1, &uiLight, 1, ucLIGHT_GetResolution());
+	vMain_StatsAdd(0, uiLight, ucLIGHT_GetResolution());
 
   //Shut down the light sensor hardware
   vLight_Shutdown();
@@ -199,20 +1283,23 @@ uint16 uiMain_SL1(uint8 * param)
 //!
 //!   \return 1: success, 0: failure
 ///////////////////////////////////////////////////////////////////////////////
-uint16 uiMain_SL2(uint8 * param)
+uint16 uiMain_SL2(uint8 ucParamLen, uint8 * param)
 {
 	uint16 uiLight;
 
+	// Answer from the background samples unless the command has its own options
+	if (ucMain_ReportCachedLight(TRANSDUCER_2, ucParamLen))
+		return 0;
+
   //Initialize the light sensor hardware
   vLight_Init();
 
   //Read the sensor and store the data
-  uiLight = unLIGHT_ReadChannel_2(&g_uiAveCounter, &g_uiDummDumm);
+  uiLight = unLIGHT_ReadChannel(2, &g_uiAveCounter);
+  uiLight = unLIGHT_Calibrate(1, uiLight, ucLIGHT_GetResolution());
 
-	S_Report[2].m_ucaData[0] = (uint8)(uiLight >> 8);
-	S_Report[2].m_ucaData[1] = (uint8) uiLight;
-	S_Report[2].m_ucLength = 2;
-	S_Report[2].m_ucFlags |= F_NEWDATA;
+	vMain_ReportLight(2, &uiLight, 1, ucLIGHT_GetResolution());
+	vMain_StatsAdd(1, uiLight, ucLIGHT_GetResolution());
 
   //Shut down the light sensor hardware
   vLight_Shutdown();
@@ -229,19 +1316,22 @@ uint16 uiMain_SL2(uint8 * param)
 //!
 //!   \return 1: success, 0: failure
 ///////////////////////////////////////////////////////////////////////////////
-uint16 uiMain_SL3(uint8 * param)
+uint16 uiMain_SL3(uint8 ucParamLen, uint8 * param)
 {
 	uint16 uiLight;
 
+	// Answer from the background samples unless the command has its own options
+	if (ucMain_ReportCachedLight(TRANSDUCER_3, ucParamLen))
+		return 0;
+
   //Initialize the light sensor hardware
   vLight_Init();
 
-  uiLight = unLIGHT_ReadChannel_3(&g_uiAveCounter, &g_uiDummDumm);
+  uiLight = unLIGHT_ReadChannel(3, &g_uiAveCounter);
+  uiLight = unLIGHT_Calibrate(2, uiLight, ucLIGHT_GetResolution());
 
-	S_Report[3].m_ucaData[0] = (uint8)(uiLight >> 8);
-	S_Report[3].m_ucaData[1] = (uint8) uiLight;
-	S_Report[3].m_ucLength = 2;
-	S_Report[3].m_ucFlags |= F_NEWDATA;
+	vMain_ReportLight(3, &uiLight, 1, ucLIGHT_GetResolution());
+	vMain_StatsAdd(2, uiLight, ucLIGHT_GetResolution());
 
   //Shut down the light sensor hardware
   vLight_Shutdown();
@@ -258,20 +1348,23 @@ uint16 uiMain_SL3(uint8 * param)
 //!
 //!   \return 1: success, 0: failure
 ///////////////////////////////////////////////////////////////////////////////
-uint16 uiMain_SL4(uint8 * param)
+uint16 uiMain_SL4(uint8 ucParamLen, uint8 * param)
 {
 	uint16 uiLight;
 
+	// Answer from the background samples unless the command has its own options
+	if (ucMain_ReportCachedLight(TRANSDUCER_4, ucParamLen))
+		return 0;
+
   //Initialize the light sensor hardware
   vLight_Init();
 
   //Read the sensor and store the data
-  uiLight = unLIGHT_ReadChannel_4(&g_uiAveCounter, &g_uiDummDumm);
+  uiLight = unLIGHT_ReadChannel(4, &g_uiAveCounter);
+  uiLight = unLIGHT_Calibrate(3, uiLight, ucLIGHT_GetResolution());
 
-	S_Report[4].m_ucaData[0] = (uint8)(uiLight >> 8);
-	S_Report[4].m_ucaData[1] = (uint8) uiLight;
-	S_Report[4].m_ucLength = 2;
-	S_Report[4].m_ucFlags |= F_NEWDATA;
+	vMain_ReportLight(4, &uiLight, 1, ucLIGHT_GetResolution());
+	vMain_StatsAdd(3, uiLight, ucLIGHT_GetResolution());
 
   //Shut down the light sensor hardware
   vLight_Shutdown();
@@ -279,6 +1372,244 @@ uint16 uiMain_SL4(uint8 * param)
 	return 1;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//!   \brief Handle for when Transducer 5 is called
+//!
+//!   Reads all four light channels in one ADC sequence so the op-amp settle
+//!   delay is only paid once. The four readings are reported in channel order.
+//!
+//!   \param g_unaCoreData.
+//!		 A pointer at the data that came from the CP board and where the result
+//!      is to be written.
+//!
+//!   \return 0: success
+///////////////////////////////////////////////////////////////////////////////
+uint16 uiMain_SLAll(uint8 ucParamLen, uint8 * param)
+{
+	uint16 uiaLight[LIGHT_NUM_CHANNELS];
+	uint8 ucChannel;
+
+	// Answer from the background samples unless the command has its own options
+	if (ucMain_ReportCachedLight(TRANSDUCER_5, ucParamLen))
+		return 0;
+
+  //Initialize the light sensor hardware
+  vLight_Init();
+
+  //Read all of the sensors in one sweep
+  vLIGHT_ReadChannels(LIGHT_ALL_CHANNELS, &g_uiAveCounter, uiaLight);
+  vMain_CalibrateSweep(uiaLight, ucLIGHT_GetResolution());
+
+	vMain_ReportLight(5, uiaLight, LIGHT_NUM_CHANNELS, ucLIGHT_GetResolution());
+	for (ucChannel = 0; ucChannel < LIGHT_NUM_CHANNELS; ucChannel++)
+		vMain_StatsAdd(ucChannel, uiaLight[ucChannel], ucLIGHT_GetResolution());
+
+  //Shut down the light sensor hardware
+  vLight_Shutdown();
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//!   \brief Handle for when Transducer 7 is called
+//!
+//!   Reports the statistics of every light reading, commanded or background,
+//!   taken since the last REQUEST_DATA.
+//!
+//!   \return 0: success
+///////////////////////////////////////////////////////////////////////////////
+uint16 uiMain_SLStats(uint8 * param)
+{
+	vMain_ReportStats(TRANSDUCER_7);
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//!   \brief Handle for when Transducer 10 is called
+//!
+//!   Reports how long each phase of the last light read took, in SMCLK/2
+//!   ticks (0.5 uS): the settle delay, the conversion of the first op-amp
+//!   group, the settle time of the second group still left after that and
+//!   the conversion of the second group. Comparing against the serial cost
+//!   (both settle delays plus both conversions) shows the pipelining gain.
+//!
+//!   \return 0: success
+///////////////////////////////////////////////////////////////////////////////
+uint16 uiMain_SLTiming(uint8 * param)
+{
+	uint8 ucPhase;
+	uint8 ucByteCnt;
+	uint16 uiTicks;
+
+	ucByteCnt = 0;
+	for (ucPhase = 0; ucPhase < LIGHT_NUM_PHASES; ucPhase++) {
+		uiTicks = unLIGHT_GetPhaseTicks(ucPhase);
+		S_Report[TRANSDUCER_10].m_ucaData[ucByteCnt++] = (uint8) (uiTicks >> 8);
+		S_Report[TRANSDUCER_10].m_ucaData[ucByteCnt++] = (uint8) uiTicks;
+	}
+
+	S_Report[TRANSDUCER_10].m_ucLength = ucByteCnt;
+	S_Report[TRANSDUCER_10].m_ucFlags |= F_NEWDATA;
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Queues the next chunk of the capture being streamed
+//!
+//! Does nothing while the previous chunk has not been fetched or once the
+//! whole capture has been handed over.
+///////////////////////////////////////////////////////////////////////////////
+void vMain_CaptureNextChunk(void)
+{
+	uint8 * pucCapture;
+	uint8 ucByteCnt;
+	uint8 ucLen;
+
+	if (g_uiCaptureSent >= g_uiCaptureBytes)
+		return;
+	if (S_Report[TRANSDUCER_11].m_ucFlags & F_NEWDATA)
+		return;
+
+	ucLen = CAPTURE_CHUNK_LEN;
+	if (g_uiCaptureBytes - g_uiCaptureSent < CAPTURE_CHUNK_LEN)
+		ucLen = (uint8) (g_uiCaptureBytes - g_uiCaptureSent);
+
+	pucCapture = pucLIGHT_GetCapture() + g_uiCaptureSent;
+
+	ucByteCnt = 0;
+	g_ucaCaptureChunk[ucByteCnt++] = g_ucCaptureSeq++;
+	// Chunk count by the reciprocal, exact for any 16-bit byte count
+	g_ucaCaptureChunk[ucByteCnt++] = (uint8) (ulFIXMATH_MulU16(g_uiCaptureBytes + CAPTURE_CHUNK_LEN - 1,
+	                                                           FIXMATH_RECIP(CAPTURE_CHUNK_LEN, 20)) >> 20);
+	while (ucLen--)
+		g_ucaCaptureChunk[ucByteCnt++] = *pucCapture++;
+
+	g_uiCaptureSent += ucByteCnt - 2;
+
+	S_Report[TRANSDUCER_11].m_ucLength = ucByteCnt;
+	S_Report[TRANSDUCER_11].m_ucFlags |= F_NEWDATA;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Drops what is left of a streaming capture
+///////////////////////////////////////////////////////////////////////////////
+void vMain_CaptureDrop(void)
+{
+	g_uiCaptureBytes = 0;
+	g_uiCaptureSent = 0;
+	g_ucCaptureSeq = 0;
+	S_Report[TRANSDUCER_11].m_ucLength = 0;
+	S_Report[TRANSDUCER_11].m_ucFlags &= ~F_NEWDATA;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//!   \brief Handle for when Transducer 11 is called
+//!
+//!   Captures raw samples of one light channel and starts streaming them.
+//!   The optional parameter bytes are the channel, the sample count and the
+//!   sample rate (see CAPTURE_PARAM_). A new capture replaces one that is
+//!   still streaming.
+//!
+//!   \param ucParamLen, number of parameter bytes; *param, the parameters
+//!
+//!   \return 0: success, 1: invalid channel
+///////////////////////////////////////////////////////////////////////////////
+uint16 uiMain_SLCapture(uint8 ucParamLen, uint8 * param)
+{
+	uint8 ucChannel;
+	uint16 uiSamples;
+	uint16 uiRate;
+
+	ucChannel = 1;
+	if (ucParamLen > CAPTURE_PARAM_CHANNEL)
+		ucChannel = param[CAPTURE_PARAM_CHANNEL];
+
+	uiSamples = LIGHT_CAPTURE_LEN;
+	if (ucParamLen > CAPTURE_PARAM_SAMPLES + 1)
+		uiSamples = ((uint16) param[CAPTURE_PARAM_SAMPLES] << 8) | param[CAPTURE_PARAM_SAMPLES + 1];
+
+	uiRate = 0;
+	if (ucParamLen > CAPTURE_PARAM_RATE + 1)
+		uiRate = ((uint16) param[CAPTURE_PARAM_RATE] << 8) | param[CAPTURE_PARAM_RATE + 1];
+
+	vMain_CaptureDrop();
+
+	vLIGHT_SetSampleRate(uiRate);
+
+	vLight_Init();
+	uiSamples = unLIGHT_Capture(ucChannel, uiSamples);
+	vLight_Shutdown();
+
+	vLIGHT_SetSampleRate(0);
+
+	if (uiSamples == 0)
+		return 1;
+
+	g_uiCaptureBytes = uiSamples / 2 * 3;
+	vMain_CaptureNextChunk();
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//!   \brief Handle for when Transducer 12 is called
+//!
+//!   Samples one light channel at LIGHT_FLICKER_HZ and reports percent
+//!   modulation, flicker index, the strongest 100/120/200/240 Hz component
+//!   and its amplitude (4 bytes, see light.h). The optional parameter byte
+//!   is the channel (default 1). The capture buffer is reused, so a capture
+//!   still streaming is dropped.
+//!
+//!   \param ucParamLen, number of parameter bytes; *param, the parameters
+//!
+//!   \return 0: success, 1: invalid channel
+///////////////////////////////////////////////////////////////////////////////
+uint16 uiMain_SLFlicker(uint8 ucParamLen, uint8 * param)
+{
+	uint8 ucChannel;
+	uint8 ucOk;
+
+	ucChannel = 1;
+	if (ucParamLen > 0)
+		ucChannel = param[0];
+
+	vMain_CaptureDrop();
+
+	vLight_Init();
+	ucOk = ucLIGHT_AnalyzeFlicker(ucChannel, S_Report[TRANSDUCER_12].m_ucaData);
+	vLight_Shutdown();
+
+	if (!ucOk)
+		return 1;
+
+	S_Report[TRANSDUCER_12].m_ucLength = LIGHT_FLICKER_REPORT_LEN;
+	S_Report[TRANSDUCER_12].m_ucFlags |= F_NEWDATA;
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//!   \brief Handle for when Transducer 13 is called
+//!
+//!   Reports the SCL rate test of the comm link (6 bytes, see
+//!   ucCOMM_RateReport()): the fastest SCL period in ns the SP received and
+//!   sent without parity or ack errors, the slowest period with errors and
+//!   the number of good and failed messages. The optional parameter byte
+//!   then starts (non zero) or stops (0) the test, clearing the results.
+//!   The CP steps its SCL rate up between calls to find the ceiling.
+//!
+//!   \param ucParamLen, number of parameter bytes; *param, the parameters
+//!
+//!   \return 0: success
+///////////////////////////////////////////////////////////////////////////////
+uint16 uiMain_SLLinkRate(uint8 ucParamLen, uint8 * param)
+{
+	S_Report[TRANSDUCER_13].m_ucLength = ucCOMM_RateReport(S_Report[TRANSDUCER_13].m_ucaData);
+	S_Report[TRANSDUCER_13].m_ucFlags |= F_NEWDATA;
+
+	if (ucParamLen > 0)
+		vCOMM_RateTest(param[0]);
+
+	return 0;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //!
 //! \brief Initializes the data storage structure
@@ -311,6 +1642,7 @@ void vMain_CleanDataStruct(void)
 ///////////////////////////////////////////////////////////////////////////////
 uint8 ucMain_FetchData(volatile uint8 * pucBuff)
 {
+	uint8 * pucData;
 	uint8 ucDataGenCnt;
 	uint8 ucByteCnt;
 	uint8 ucLength;
@@ -318,20 +1650,35 @@ uint8 ucMain_FetchData(volatile uint8 * pucBuff)
 	// Assume no data
 	ucLength = 0;
 
+	// A new statistics window starts with every data request
+	vMain_StatsReset();
+
+	// Hand over the dose integrated since the last request
+	if (g_ucDoseActive)
+		vMain_ReportDose(TRANSDUCER_8);
+
+	// One chunk of a streaming capture per request
+	vMain_CaptureNextChunk();
+
 	// Check all the data generators for new data
 	for (ucDataGenCnt = 0; ucDataGenCnt < NUMDATGEN; ucDataGenCnt++) {
 		// If there is new data to report then write to the passed buffer
 		if (S_Report[ucDataGenCnt].m_ucFlags & F_NEWDATA) {
+			// Leave data that does not fit for the next request
+			if (ucLength + S_Report[ucDataGenCnt].m_ucLength + 2 > SP_MAXPAYLOADLEN)
+				continue;
+
 			// write the data generator ID and the length of this message
 			*pucBuff++ = ucDataGenCnt;
 			*pucBuff++ = S_Report[ucDataGenCnt].m_ucLength;
 
 			// write the data
+			pucData = pucMain_ReportData(ucDataGenCnt);
 			for (ucByteCnt = 0; ucByteCnt < S_Report[ucDataGenCnt].m_ucLength; ucByteCnt++) {
-				*pucBuff++ = S_Report[ucDataGenCnt].m_ucaData[ucByteCnt];
+				*pucBuff++ = pucData[ucByteCnt];
 
 				// Once the byte is shipped, delete it
-				S_Report[ucDataGenCnt].m_ucaData[ucByteCnt] = 0;
+				pucData[ucByteCnt] = 0;
 			}
 
 			// Update the length variable. Includes raw data, data generator ID, and length byte lengths
@@ -344,9 +1691,35 @@ uint8 ucMain_FetchData(volatile uint8 * pucBuff)
 		}
 	}
 
+	// The CP has the threshold event, stop signalling it
+	if (!(S_Report[TRANSDUCER_9].m_ucFlags & F_NEWDATA))
+		vMain_ReleaseInterrupt();
+
 	return ucLength;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! \brief Checks for data left behind by the last ucMain_FetchData()
+//!
+//! \return 1 if a data generator is still pending or a capture is still
+//! streaming, the CP should send another REQUEST_DATA
+///////////////////////////////////////////////////////////////////////////////
+uint8 ucMain_DataPending(void)
+{
+	uint8 ucDataGenCnt;
+
+	if (g_uiCaptureSent < g_uiCaptureBytes)
+		return 1;
+
+	for (ucDataGenCnt = 0; ucDataGenCnt < NUMDATGEN; ucDataGenCnt++) {
+		if (S_Report[ucDataGenCnt].m_ucFlags & F_NEWDATA)
+			return 1;
+	}
+
+	return 0;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //!
 //! \brief Fetches the requested transducer label and writes it to the passed array
@@ -384,6 +1757,51 @@ void vMain_FetchLabel(uint8 ucTransNum, volatile uint8 * pucLabelArray)
 			for (ucLoopCount = 0x00; ucLoopCount < TRANSDUCER_LABEL_LEN; ucLoopCount++)
 				*pucLabelArray++ = TRANSDUCER_4_LABEL_TXT[ucLoopCount];
 		break;
+
+		case TRANSDUCER_5:
+			for (ucLoopCount = 0x00; ucLoopCount < TRANSDUCER_LABEL_LEN; ucLoopCount++)
+				*pucLabelArray++ = TRANSDUCER_5_LABEL_TXT[ucLoopCount];
+		break;
+
+		case TRANSDUCER_6:
+			for (ucLoopCount = 0x00; ucLoopCount < TRANSDUCER_LABEL_LEN; ucLoopCount++)
+				*pucLabelArray++ = TRANSDUCER_6_LABEL_TXT[ucLoopCount];
+		break;
+
+		case TRANSDUCER_7:
+			for (ucLoopCount = 0x00; ucLoopCount < TRANSDUCER_LABEL_LEN; ucLoopCount++)
+				*pucLabelArray++ = TRANSDUCER_7_LABEL_TXT[ucLoopCount];
+		break;
+
+		case TRANSDUCER_8:
+			for (ucLoopCount = 0x00; ucLoopCount < TRANSDUCER_LABEL_LEN; ucLoopCount++)
+				*pucLabelArray++ = TRANSDUCER_8_LABEL_TXT[ucLoopCount];
+		break;
+
+		case TRANSDUCER_9:
+			for (ucLoopCount = 0x00; ucLoopCount < TRANSDUCER_LABEL_LEN; ucLoopCount++)
+				*pucLabelArray++ = TRANSDUCER_9_LABEL_TXT[ucLoopCount];
+		break;
+
+		case TRANSDUCER_10:
+			for (ucLoopCount = 0x00; ucLoopCount < TRANSDUCER_LABEL_LEN; ucLoopCount++)
+				*pucLabelArray++ = TRANSDUCER_10_LABEL_TXT[ucLoopCount];
+		break;
+
+		case TRANSDUCER_11:
+			for (ucLoopCount = 0x00; ucLoopCount < TRANSDUCER_LABEL_LEN; ucLoopCount++)
+				*pucLabelArray++ = TRANSDUCER_11_LABEL_TXT[ucLoopCount];
+		break;
+
+		case TRANSDUCER_12:
+			for (ucLoopCount = 0x00; ucLoopCount < TRANSDUCER_LABEL_LEN; ucLoopCount++)
+				*pucLabelArray++ = TRANSDUCER_12_LABEL_TXT[ucLoopCount];
+		break;
+
+		case TRANSDUCER_13:
+			for (ucLoopCount = 0x00; ucLoopCount < TRANSDUCER_LABEL_LEN; ucLoopCount++)
+				*pucLabelArray++ = TRANSDUCER_13_LABEL_TXT[ucLoopCount];
+		break;
 		
 		default:
 			for (ucLoopCount = 0x00; ucLoopCount < TRANSDUCER_LABEL_LEN; ucLoopCount++)
@@ -450,6 +1868,39 @@ uint8 ucMain_getTransducerType(uint8 ucTransNum)
 		case TRANSDUCER_2:
 		case TRANSDUCER_3:
 		case TRANSDUCER_4:
+		case TRANSDUCER_5:
+			ucRetVal = TYPE_IS_SENSOR;
+		break;
+
+		case TRANSDUCER_6:
+			ucRetVal = TYPE_IS_ACTUATOR;
+		break;
+
+		case TRANSDUCER_7:
+			ucRetVal = TYPE_IS_SENSOR;
+		break;
+
+		case TRANSDUCER_8:
+			ucRetVal = TYPE_IS_SENSOR;
+		break;
+
+		case TRANSDUCER_9:
+			ucRetVal = TYPE_IS_SENSOR;
+		break;
+
+		case TRANSDUCER_10:
+			ucRetVal = TYPE_IS_SENSOR;
+		break;
+
+		case TRANSDUCER_11:
+			ucRetVal = TYPE_IS_SENSOR;
+		break;
+
+		case TRANSDUCER_12:
+			ucRetVal = TYPE_IS_SENSOR;
+		break;
+
+		case TRANSDUCER_13:
 			ucRetVal = TYPE_IS_SENSOR;
 		break;
 
@@ -491,6 +1942,10 @@ uint16 uiMainDispatch(uint8 ucCmdTransNum, uint8 ucCmdParamLen, uint8 *ucParam)
 
 	uint8 ucRetVal;
 
+	// The light transducers take their acquisition options from the parameters
+	if (ucCmdTransNum >= TRANSDUCER_1 && ucCmdTransNum <= TRANSDUCER_5)
+		vMain_ApplyLightParams(ucCmdParamLen, ucParam);
+
 	switch (ucCmdTransNum)
 	{
 		case 0:
@@ -498,19 +1953,55 @@ uint16 uiMainDispatch(uint8 ucCmdTransNum, uint8 ucCmdParamLen, uint8 *ucParam)
 		break;
 
 		case 1:
-			ucRetVal = uiMain_SL1(ucParam);
+			ucRetVal = uiMain_SL1(ucCmdParamLen, ucParam);
 		break;
 
 		case 2:
-			ucRetVal = uiMain_SL2(ucParam);
+			ucRetVal = uiMain_SL2(ucCmdParamLen, ucParam);
 		break;
 
 		case 3:
-			ucRetVal = uiMain_SL3(ucParam);
+			ucRetVal = uiMain_SL3(ucCmdParamLen, ucParam);
 		break;
 
 		case 4:
-			ucRetVal = uiMain_SL4(ucParam);
+			ucRetVal = uiMain_SL4(ucCmdParamLen, ucParam);
+		break;
+
+		case 5:
+			ucRetVal = uiMain_SLAll(ucCmdParamLen, ucParam);
+		break;
+
+		case 6:
+			ucRetVal = uiMain_SLBackground(ucCmdParamLen, ucParam);
+		break;
+
+		case 7:
+			ucRetVal = uiMain_SLStats(ucParam);
+		break;
+
+		case 8:
+			ucRetVal = uiMain_SLDose(ucCmdParamLen, ucParam);
+		break;
+
+		case 9:
+			ucRetVal = uiMain_SLThreshold(ucCmdParamLen, ucParam);
+		break;
+
+		case 10:
+			ucRetVal = uiMain_SLTiming(ucParam);
+		break;
+
+		case 11:
+			ucRetVal = uiMain_SLCapture(ucCmdParamLen, ucParam);
+		break;
+
+		case 12:
+			ucRetVal = uiMain_SLFlicker(ucCmdParamLen, ucParam);
+		break;
+
+		case 13:
+			ucRetVal = uiMain_SLLinkRate(ucCmdParamLen, ucParam);
 		break;
 
 		default:
@@ -534,17 +2025,48 @@ uint16 uiMainDispatch(uint8 ucCmdTransNum, uint8 ucCmdParamLen, uint8 *ucParam)
 ///////////////////////////////////////////////////////////////////////////////
 void vMain_EventTrigger(void)
 {
-//	uint8 ucParam;
-//
-//	// If the turn off the valve flag is true then dispatch to the function
-//	if (g_ucEventTrigger & some flag) {
-//
-//		// Clear the flag
-//		g_ucEventTrigger &= ~some flag;
-//
-//		// Pull the interrrupt line high to tell the CP that we have data
-//		P_INT_OUT |= INT_PIN;
-//	}
+	// The background sampling period has elapsed
+	if (g_ucEventTrigger & EVENT_LIGHT_SAMPLE) {
+
+		// Clear the flag
+		g_ucEventTrigger &= ~EVENT_LIGHT_SAMPLE;
+
+		vMain_BackgroundSample();
+	}
+
+	// Nothing followed the last COMMAND_PKT, power the front end down
+	if (g_ucEventTrigger & EVENT_LIGHT_RELEASE) {
+
+		// Clear the flag
+		g_ucEventTrigger &= ~EVENT_LIGHT_RELEASE;
+
+		vLIGHT_Hold(0);
+		if (g_uiBgPeriod == 0)
+			vMain_StopSecondTick();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief Background sampling timer
+//!
+//! Fires once a second from ACLK. When the sampling period or the warm-hold
+//! time has elapsed the event flag is set, and the core is woken from LPM3
+//! for as long as an event is pending so that vMain_EventTrigger() gets to
+//! run.
+///////////////////////////////////////////////////////////////////////////////
+#pragma vector = TIMERA0_VECTOR
+__interrupt void TIMERA0_ISR(void)
+{
+	if (g_uiBgPeriod && --g_uiBgSecondsLeft == 0) {
+		g_uiBgSecondsLeft = g_uiBgPeriod;
+		g_ucEventTrigger |= EVENT_LIGHT_SAMPLE;
+	}
+
+	if (g_uiWarmSecondsLeft && --g_uiWarmSecondsLeft == 0)
+		g_ucEventTrigger |= EVENT_LIGHT_RELEASE;
+
+	if (g_ucEventTrigger)
+		__bic_SR_register_on_exit(LPM3_bits);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -554,6 +2076,15 @@ void vMain_EventTrigger(void)
 //! \return 1 if shutdown is OK
 ///////////////////////////////////////////////////////////////////////////////
 uint8 ucMain_ShutdownAllowed(void){
+
+	// Background sampling needs the power to stay on
+	if (g_uiBgPeriod != 0)
+		return 0;
+
+	// Data the CP has not fetched yet would be lost
+	if (ucMain_DataPending())
+		return 0;
+
 	return 1;
 }
 
@@ -582,6 +2113,16 @@ void main(void)
 	// Clear the event trigger flags
 	g_ucEventTrigger = 0;
 
+	// No thresholds until the CP sets them
+	vMain_ThresholdInit();
+
+	// Report in engineering units if the board has been calibrated
+	vMain_LoadCalibration();
+
+	// Measure the VLO so the background timer keeps time
+	vMain_CalibrateVLO();
+	vMain_SetBackgroundPeriod(0);
+
 	//Run core
 	vCORE_Run();
 }